@@ -0,0 +1,180 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Bit-packed matrices over GF(2)
+ */
+
+#ifndef BITMATRIX_H
+#define BITMATRIX_H
+
+#include <rnc-lib/mt.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace rnc
+{
+namespace matrix
+{
+        struct context;
+
+        /** \brief Matrix over GF(2), 64 coefficients per word
+
+            Binary network coding trades a higher probability of
+            non-innovative packets for speed: the only operation needed on the
+            data is XORing whole rows.
+
+            Element (i, j) is bit j%64 of rows[i][j/64]; the bits beyond \c
+            ncols in the last word of a row are kept zero. A data block of \c
+            n bytes, \c n divisible by 8, is a row of 8n columns, so the same
+            type holds both the coefficients and the data.
+
+            The operations of the same name as the ones of #basic_matrix are
+            overloaded for this type, so code can switch between the fields
+            without changes.
+         */
+        struct BitMatrix {
+                typedef uint64_t Word; ///< Storage unit of 64 elements
+                typedef Word *Row;     ///< Row address
+
+                Row *rows;
+                size_t nrows;
+                size_t ncols;
+                size_t nwords;         ///< Words per row
+                Word *data;            ///< Memory area of the rows
+                bool cleanup;
+
+                /// \brief Words needed for a row of \c ncols elements
+                static size_t words(size_t ncols) {
+                        return (ncols + 63) / 64; }
+
+                BitMatrix(const BitMatrix &)
+                {
+                        throw std::string("Matrix object cannot be copied: not implemented.");
+                }
+                /** \brief Matrix on a contiguous memory area of \c nrows *
+                    words(ncols) words
+                 */
+                BitMatrix(Word *memarea, size_t nrows, size_t ncols)
+                        : rows(new Row[nrows]),
+                          nrows(nrows),
+                          ncols(ncols),
+                          nwords(words(ncols)),
+                          data(memarea),
+                          cleanup(false)
+                {
+                        for (size_t i=0; i<nrows; ++i)
+                                rows[i] = data + i*nwords;
+                }
+                /** \brief Allocates a matrix of zeroes
+
+                    The data is always initialized, as the padding bits must
+                    be zero.
+                 */
+                BitMatrix(size_t nrows, size_t ncols)
+                        : rows(new Row[nrows]),
+                          nrows(nrows),
+                          ncols(ncols),
+                          nwords(words(ncols)),
+                          data(new Word[nrows*nwords]()),
+                          cleanup(true)
+                {
+                        for (size_t i=0; i<nrows; ++i)
+                                rows[i] = data + i*nwords;
+                }
+                ~BitMatrix()
+                {
+                        if (cleanup) delete [] data;
+                        delete [] rows;
+                }
+
+                /// \brief Element (i, j)
+                bool get(size_t i, size_t j) const {
+                        return (rows[i][j/64] >> (j%64)) & 1; }
+                /// \brief Sets element (i, j) to \c v
+                void set(size_t i, size_t j, bool v) {
+                        const Word bit = Word(1) << (j%64);
+                        if (v) rows[i][j/64] |= bit;
+                        else rows[i][j/64] &= ~bit;
+                }
+        };
+
+        /// \addtogroup matr_ops Operations
+        /// @{
+
+        /** \brief Initialize a matrix to identity. */
+        void set_identity(BitMatrix &m) throw();
+        /** \brief Initialize a matrix with zeroes. */
+        void set_zero(BitMatrix &m) throw();
+        /** \brief Copy a matrix
+            @param m Matrix to be copied
+            @param md Destination matrix
+         */
+        void copy(const BitMatrix &m, BitMatrix &md) throw();
+
+        /** \brief Invert a matrix over GF(2)
+
+            Gauss-Jordan elimination by the Method of Four Russians (M4RI): \c
+            k pivot rows are found at a time, and all the other rows are
+            reduced at once by a single lookup in a table of the \f$2^k\f$
+            combinations of the pivot rows.
+
+            @param m Matrix to be inverted
+            @param res Result address
+            @return false, if \c m is singular
+            \throw std::bad_alloc If the work areas cannot be allocated.
+         */
+        bool invert(const BitMatrix &m, BitMatrix &res);
+
+        /** \brief Matrix multiplication over GF(2): \f$md:=m1*m2\f$
+
+            Method of Four Russians: the rows of \c m2 are taken \c k at a
+            time, the \f$2^k\f$ combinations of them are tabulated, and each
+            row of \c md is updated by a single lookup per group. The
+            columns of \c m2 are processed in strips, so that the table stays
+            in the cache.
+
+            \c md must be of size (m1.nrows x m2.ncols), and must not be \c
+            m1 or \c m2.
+         */
+        void mul(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md);
+
+        /** \brief Parallel matrix multiplication over GF(2): \f$md:=m1*m2\f$
+
+            Same as #mul, but the column strips are distributed among #NCPUS
+            threads of the worker pool (see rnc::pool).
+         */
+        void pmul(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md);
+
+        /** \brief #pmul with the thread count of \c ctx
+
+            The other settings of a context do not apply over GF(2), so #mul
+            and #invert take none.
+         */
+        void pmul(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md,
+                  const context &ctx);
+
+        /** \brief Generates a random matrix over GF(2). */
+        void rand_matr(BitMatrix &m, random::mt_state *rnd_state);
+
+        ///@}
+}
+}
+
+#endif //BITMATRIX_H
@@ -0,0 +1,454 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Coding packet by packet
+*/
+
+#ifndef CODING_H
+#define CODING_H
+
+#include <rnc-lib/matrix.h>
+#include <stdint.h>
+#include <vector>
+
+namespace rnc
+{
+/** \brief Coding of a generation packet by packet
+
+    A generation consists of \c n source blocks of \c ncols elements each. A
+    coded packet is a linear combination of them: its coefficient vector of
+    \c n elements and its payload of \c ncols elements, the combination of
+    the sources by these coefficients.
+
+    The classes are templates over the field; they are instantiated in the
+    library for Field<GF256>, Field<GF65536> and Field<GF2_32>.
+ */
+namespace coding
+{
+        using namespace matrix;
+
+        /** \brief Coefficient vector of \c n elements reproduced from \c seed
+
+            A packet may carry the seed of its coefficients instead of the
+            vector. The elements are drawn from an mt_state initialized with
+            the reference TinyMT parameters and \c seed, so every node
+            regenerates the same vector.
+         */
+        template <class Fq>
+        void seed_coefficients(random::random_type seed,
+                               typename Fq::fq_t *coefs, size_t n);
+
+        /** \brief Encoder of a generation, packet by packet
+
+            Produces coded packets on demand from the source blocks, the
+            rows of a matrix, so that a sender emits as many packets as the
+            channel needs without computing a matrix of them at once. The
+            payload is computed by the panel kernels (see
+            rnc::fq::region_ops::addto_mul_panel), combining
+            context::panel_depth sources per pass over it.
+
+            The encoder refers to the sources; they must outlive it.
+
+            \tparam Fq Field<GF256>, Field<GF65536> or Field<GF2_32>
+         */
+        template <class Fq>
+        class basic_encoder
+        {
+        public:
+                typedef Fq field;                    ///< The field
+                typedef typename Fq::fq_t Element;   ///< Element type
+                typedef basic_matrix<Fq> Matrix;     ///< Matrix type
+
+                /** \brief Encoder of the rows of \c sources
+
+                    @param ctx Kernels to use; the encoder keeps a copy
+                 */
+                basic_encoder(const Matrix &sources,
+                              const context &ctx = context());
+
+                /** \brief Payload of the combination \c coefs
+
+                    @param coefs Coefficient vector of #size elements
+                    @param payload Result of #ncols elements
+                 */
+                void encode(const Element *coefs, Element *payload);
+                /** \brief A coded packet with random coefficients
+
+                    @param coefs Result, a coefficient vector of #size
+                    elements drawn from \c rnd_state
+                    @param payload Result of #ncols elements
+                 */
+                void encode(random::mt_state *rnd_state,
+                            Element *coefs, Element *payload);
+                /** \brief Payload of the combination #seed_coefficients
+                    of \c seed
+
+                    @param payload Result of #ncols elements
+                 */
+                void encode(random::random_type seed, Element *payload);
+
+                /// \brief Number of sources
+                size_t size() const { return _sources.nrows; }
+                /// \brief Elements of a source block
+                size_t ncols() const { return _sources.ncols; }
+                /// \brief The sources as rows
+                const Matrix &sources() const { return _sources; }
+                /** \brief Systematic packet \c i: source \c i itself,
+                    with the unit vector \f$e_i\f$ as its coefficients
+
+                    A systematic code sends these before any coded packet,
+                    at no cost; see basic_decoder::add_source.
+                 */
+                const Element *source(size_t i) const {
+                        return RA(_sources, i); }
+
+        private:
+                basic_encoder(const basic_encoder &);
+                basic_encoder &operator=(const basic_encoder &);
+
+                const Matrix &_sources;
+                /// \brief Settings of the operations
+                const context _ctx;
+                /// \brief Sources combined per pass
+                const size_t _depth;
+                /// \brief Prepared coefficients of a pass
+                std::vector<uint64_t> _prep;
+                /// \brief Sources of a pass
+                std::vector<const Element*> _src;
+                /// \brief Coefficients regenerated from a seed
+                std::vector<Element> _seeded;
+        };
+
+        /// \brief Encoder over the default field (see #Q256)
+        typedef basic_encoder<default_field> Encoder;
+
+        /** \brief Progressive decoder of a generation
+
+            Coded packets are eliminated one by one as they arrive, so that
+            the work is spread over the reception of the generation instead
+            of being done at once when the last packet arrives.
+
+            The received rows are kept in reduced row echelon form, row \c c
+            holding the packet whose pivot is in column \c c. Reducing the
+            coefficients of a new packet by the rows takes a row operation on
+            \c n elements per pivot; if nothing is left, the packet is not
+            innovative, and it is dropped without touching any payload.
+            Otherwise its payload is combined with the rows it was reduced
+            by in a single pass (see rnc::fq::region_ops::addto_mul_panel),
+            and its pivot is cleared from the earlier rows. So the
+            back-substitution is done along the way: when the rank reaches \c
+            n, the rows are the sources.
+
+            \tparam Fq Field<GF256>, Field<GF65536> or Field<GF2_32>
+         */
+        template <class Fq>
+        class basic_decoder
+        {
+        public:
+                typedef Fq field;                    ///< The field
+                typedef typename Fq::fq_t Element;   ///< Element type
+                typedef basic_matrix<Fq> Matrix;     ///< Matrix type
+
+                /** \brief Decoder of \c n sources of \c ncols elements
+
+                    @param ctx Kernels to use; the decoder keeps a copy
+                 */
+                basic_decoder(size_t n, size_t ncols,
+                              const context &ctx = context());
+
+                /** \brief Adds a coded packet
+
+                    @param coefs Coefficient vector of \c n elements
+                    @param payload Payload of \c ncols elements
+
+                    \return Whether the packet was innovative, i.e. it
+                    increased the rank
+                 */
+                bool add(const Element *coefs, const Element *payload);
+                /** \brief Adds a coded packet with the coefficients
+                    #seed_coefficients of \c seed
+
+                    The vector is regenerated here, where the elimination
+                    needs it, and not kept afterwards.
+                 */
+                bool add(random::random_type seed, const Element *payload);
+                /** \brief Adds source \c i received uncoded
+
+                    The packet of a systematic code (see
+                    basic_encoder::source); same as #add with the unit vector
+                    \f$e_i\f$, without eliminating it. The coded packets
+                    then combine the sources received this way by their
+                    payloads only.
+
+                    \return Whether the source was missing
+                 */
+                bool add_source(size_t i, const Element *payload);
+
+                /// \brief Number of sources
+                size_t size() const { return _coefs.nrows; }
+                /// \brief Elements of a source block
+                size_t ncols() const { return _data.ncols; }
+                /// \brief Number of innovative packets received
+                size_t rank() const { return _rank; }
+                /// \brief Whether all the sources are decoded
+                bool complete() const { return _rank == size(); }
+
+                /** \brief Whether source \c i is decoded already
+
+                    A source may be decoded before the generation is
+                    complete, e.g. if it was received uncoded.
+                 */
+                bool decoded(size_t i) const;
+                /// \brief Source \c i; valid once #decoded
+                const Element *source(size_t i) const { return RA(_data, i); }
+                /// \brief The sources as rows; valid once #complete
+                const Matrix &data() const { return _data; }
+
+        protected:
+                /// \brief Settings of the operations
+                const context _ctx;
+                /// \brief Coefficients of the rows, \c n x \c n
+                Matrix _coefs;
+                /// \brief Payloads of the rows, \c n x \c ncols
+                Matrix _data;
+                /// \brief Whether row \c c is present
+                std::vector<char> _pivot;
+                /** \brief Whether row \c c is known to be a unit vector,
+                    i.e. a decoded source */
+                std::vector<char> _unit;
+                size_t _rank;
+
+                /// \brief The coefficient vector being reduced
+                std::vector<Element> _v;
+                /// \brief Prepared multipliers of the rows combined
+                std::vector<uint64_t> _prep;
+                /// \brief Payloads of the rows combined
+                std::vector<const Element*> _src;
+
+                /// \brief #add with the coefficients copied to #_v
+                bool insert(const Element *payload);
+                /// \brief Clears column \c p from the rows but row \c p
+                void clear(size_t p);
+
+        private:
+                basic_decoder(const basic_decoder &);
+                basic_decoder &operator=(const basic_decoder &);
+        };
+
+        /// \brief Decoder over the default field (see #Q256)
+        typedef basic_decoder<default_field> Decoder;
+
+        /** \brief Recoder of a generation at an intermediate node
+
+            Mixes the coded packets received so far into new ones, without
+            decoding them first: a relay can forward an innovative packet as
+            soon as it has received one. A packet sent is a random
+            combination of the rows received, with the combination of their
+            coefficient vectors as its coefficients, so it is a valid coded
+            packet of the sources.
+
+            The packets received are kept by the #basic_decoder it extends:
+            non-innovative ones are dropped, and the rows being eliminated
+            does not change the space they span. The sources are decoded
+            along the way, if the relay needs them.
+
+            The packets sent carry their coefficient vectors: a combination
+            of the vectors of several seeds has no seed of its own.
+
+            \tparam Fq Field<GF256>, Field<GF65536> or Field<GF2_32>
+         */
+        template <class Fq>
+        class basic_recoder : public basic_decoder<Fq>
+        {
+        public:
+                typedef typename basic_decoder<Fq>::Element Element;
+
+                /// \brief Recoder of \c n sources of \c ncols elements
+                basic_recoder(size_t n, size_t ncols,
+                              const context &ctx = context());
+
+                /** \brief A random combination of the packets received
+
+                    @param coefs Result, a coefficient vector of \c n
+                    elements
+                    @param payload Result of \c ncols elements
+
+                    \return Whether a packet was produced, i.e. any
+                    innovative packet has been received
+                 */
+                bool recode(random::mt_state *rnd_state,
+                            Element *coefs, Element *payload);
+
+        private:
+                /// \brief Coefficient vectors of the rows combined
+                std::vector<const Element*> _csrc;
+        };
+
+        /// \brief Recoder over the default field (see #Q256)
+        typedef basic_recoder<default_field> Recoder;
+
+        /** \brief Encoder of a stream over a sliding window
+
+            Sources are numbered in the order they are pushed, and a coded
+            packet combines only the last #window of them, \f$[first,
+            end)\f$. So a receiver can decode a source as soon as it has
+            enough packets of the window around it, instead of waiting for
+            a whole generation.
+
+            \tparam Fq Field<GF256>, Field<GF65536> or Field<GF2_32>
+         */
+        template <class Fq>
+        class basic_window_encoder
+        {
+        public:
+                typedef Fq field;                    ///< The field
+                typedef typename Fq::fq_t Element;   ///< Element type
+                typedef basic_matrix<Fq> Matrix;     ///< Matrix type
+
+                /** \brief Encoder of sources of \c ncols elements, combining
+                    at most \c window of them */
+                basic_window_encoder(size_t window, size_t ncols,
+                                     const context &ctx = context());
+
+                /** \brief Appends source #end to the window
+
+                    The oldest source leaves the window if it is full.
+                 */
+                void push(const Element *source);
+
+                /** \brief A coded packet of the window with random
+                    coefficients
+
+                    @param coefs Result, coefficient \c t belonging to source
+                    \c first+t, #count elements
+                    @param payload Result of #ncols elements
+                 */
+                void encode(random::mt_state *rnd_state,
+                            Element *coefs, Element *payload);
+
+                /// \brief Number of the oldest source in the window
+                size_t first() const { return _end - _count; }
+                /// \brief Number of the next source pushed
+                size_t end() const { return _end; }
+                /// \brief Sources in the window
+                size_t count() const { return _count; }
+                /// \brief Maximum number of sources in the window
+                size_t window() const { return _sources.nrows; }
+                /// \brief Elements of a source block
+                size_t ncols() const { return _sources.ncols; }
+
+        private:
+                basic_window_encoder(const basic_window_encoder &);
+                basic_window_encoder &operator=(const basic_window_encoder &);
+
+                /// \brief Settings of the operations
+                const context _ctx;
+                /// \brief Source \c s in row <tt>s % window</tt>
+                Matrix _sources;
+                size_t _end;
+                size_t _count;
+                /// \brief Prepared coefficients of the window
+                std::vector<uint64_t> _prep;
+                /// \brief Sources of the window
+                std::vector<const Element*> _src;
+        };
+
+        /// \brief Sliding window encoder over the default field
+        typedef basic_window_encoder<default_field> WindowEncoder;
+
+        /** \brief Decoder of a stream coded over a sliding window
+
+            Delivers the sources in order: #ready tells whether the next
+            one is decoded, as soon as the packets received determine it.
+
+            The decoder keeps the sources of the last \c window numbers,
+            \f$[base, base+window)\f$, as the rows of a #basic_decoder of
+            \c window sources used as a ring: source \c s is its column
+            <tt>s % window</tt>. The packets are eliminated as they arrive,
+            and decoded sources stay in the ring after they are delivered,
+            to be eliminated from the packets that still combine them.
+
+            A packet beyond the ring moves \c base forward. The sources
+            leaving the ring undelivered are lost (see #lost), as are the
+            rows still combining them; so \c window should exceed that of
+            the encoder by the reordering and loss the channel needs to
+            tolerate. A packet combining a source before \c base is
+            dropped.
+
+            \tparam Fq Field<GF256>, Field<GF65536> or Field<GF2_32>
+         */
+        template <class Fq>
+        class basic_window_decoder : private basic_decoder<Fq>
+        {
+                typedef basic_decoder<Fq> ring;
+        public:
+                typedef typename ring::field field;     ///< The field
+                typedef typename ring::Element Element; ///< Element type
+                typedef typename ring::Matrix Matrix;   ///< Matrix type
+
+                /** \brief Decoder of sources of \c ncols elements, keeping
+                    \c window of them */
+                basic_window_decoder(size_t window, size_t ncols,
+                                     const context &ctx = context());
+
+                /** \brief Adds a coded packet of sources
+                    \f$[first, first+count)\f$
+
+                    @param coefs Coefficient \c t belonging to source
+                    \c first+t; \c count is at most #window
+                    @param payload Payload of #ncols elements
+
+                    \return Whether the packet was innovative
+                 */
+                bool add(size_t first, size_t count,
+                         const Element *coefs, const Element *payload);
+
+                /// \brief Whether source #next is decoded
+                bool ready() const {
+                        return _next < _base + window()
+                                && ring::decoded(_next % window()); }
+                /// \brief Source #next; valid if #ready
+                const Element *front() const {
+                        return ring::source(_next % window()); }
+                /// \brief Delivers source #next, moving on to the following
+                void pop() { ++_next; }
+                /// \brief Number of the next source to deliver
+                size_t next() const { return _next; }
+                /// \brief Sources skipped undecoded
+                size_t lost() const { return _lost; }
+                /// \brief Sources kept
+                size_t window() const { return ring::size(); }
+                /// \brief Elements of a source block
+                size_t ncols() const { return ring::ncols(); }
+
+        private:
+                /// \brief Moves the ring forward to start at \c base
+                void slide(size_t base);
+
+                size_t _base;
+                size_t _next;
+                size_t _lost;
+        };
+
+        /// \brief Sliding window decoder over the default field
+        typedef basic_window_decoder<default_field> WindowDecoder;
+}
+}
+
+#endif //CODING_H
@@ -0,0 +1,407 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Finite fields as template parameters
+ */
+
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rnc
+{
+namespace fq
+{
+        /// \addtogroup fqregion Region operations over the finite field
+        /// @{
+
+        /** \brief Region kernels of a single field
+
+            Compute \f$dst_i:=dst_i+(c*src_i)\f$ or \f$dst_i:=c*src_i\f$ for
+            \f$0 \le i < n\f$.
+         */
+        template <class E>
+        struct region_ops
+        {
+                /// \brief \f$dst:=dst+c*src\f$
+                void (*addto_mul)(E *dst, const E *src, E c, size_t n);
+                /// \brief \f$dst:=c*src\f$
+                void (*mul)(E *dst, const E *src, E c, size_t n);
+                /** \brief \f$dst:=dst+g^{lc}*src\f$, \c lc being the
+                    logarithm of a non-zero coefficient
+
+                    Only for the fields with logarithm tables; 0 otherwise.
+                 */
+                void (*addto_mul_log)(E *dst, const E *src, E lc, size_t n);
+
+                /// \brief Bytes of a coefficient prepared by #prepare
+                size_t prepared_size;
+                /** \brief Prepares the non-zero coefficient \c c for
+                    #addto_mul_panel (e.g. computes its product tables) at
+                    \c p, #prepared_size bytes aligned to 8 */
+                void (*prepare)(void *p, E c);
+                /** \brief \f$dst:=dst+\sum_{t<k} c_t*src_t\f$, the
+                    coefficients prepared at \c p
+
+                    Region \c t is \f$src_t[off, off+n)\f$. Several source
+                    regions are combined in registers before \c dst is
+                    stored, and the coefficient tables are reused across
+                    calls.
+                 */
+                void (*addto_mul_panel)(E *dst, const E * const *src,
+                                        size_t off, const void *p,
+                                        size_t k, size_t n);
+                /** \brief #prepare for the non-zero coefficient
+                    \f$g^{lc}\f$, given by its logarithm
+
+                    The generic kernels multiply by logarithms, and store \c
+                    lc as it is; the others look up the coefficient once.
+                    Only for the fields with logarithm tables; 0 otherwise.
+                 */
+                void (*prepare_log)(void *p, E lc);
+        };
+
+        /** \brief Implementation tiers of the region kernels
+
+            Listed in order of preference; #KERNEL_AUTO selects the last one
+            supported by the CPU.
+         */
+        enum kernel_tier
+        {
+                KERNEL_GENERIC = 0, ///< Portable log/power table lookups
+                KERNEL_SSE2,        ///< Shift-and-add over 128 bit vectors
+                KERNEL_SSSE3,       ///< Split-nibble tables, 128 bit PSHUFB
+                KERNEL_AVX2,        ///< Split-nibble tables, 256 bit PSHUFB
+                KERNEL_AVX512BW,    ///< Split-nibble tables, 512 bit PSHUFB
+                KERNEL_GFNI,        ///< GF(2^8) affine instructions (with AVX2)
+                KERNEL_AUTO         ///< Best tier supported by the CPU
+        };
+
+        /** \brief A set of region kernels of the same implementation tier */
+        struct kernel_set
+        {
+                kernel_tier tier;             ///< Implementation tier
+                const char *name;             ///< Name of the tier
+                region_ops<uint8_t> gf256;    ///< Kernels over #GF256
+                region_ops<uint16_t> gf65536; ///< Kernels over #GF65536
+                region_ops<uint32_t> gf2_32;  ///< Kernels over #GF2_32
+        };
+
+        /** \brief The kernel set used by the region operations.
+
+            Bound when the library is loaded: to the tier named by the \e
+            RNC_KERNEL environment variable (\e generic, \e sse2, \e ssse3,
+            \e avx2, \e avx512bw or \e gfni), if it is set and supported by
+            the CPU; otherwise to the best tier supported. Use #select_kernel
+            to change it.
+         */
+        extern const kernel_set *active_kernel;
+
+        /** \brief Whether the CPU (and the library build) supports a tier. */
+        bool cpu_supports(kernel_tier tier);
+
+        /** \brief Force a specific kernel tier, e.g. for benchmarking
+
+            \return The newly active kernel set, or 0 if \c tier is not
+            supported. In the latter case, #active_kernel is unchanged.
+
+            \remark Not thread-safe: must not be called while region operations
+            are being performed.
+         */
+        const kernel_set *select_kernel(kernel_tier tier = KERNEL_AUTO);
+
+        /** \brief Name of the active kernel tier (e.g. "avx2") */
+        inline const char *kernel_name() {
+                return active_kernel->name; }
+
+        ///@}
+
+        /// \addtogroup fields Field descriptors
+        /// @{
+
+        /** \brief Discrete logarithm and power tables
+
+            Generated at compile time from the polynomial and the generator of
+            the field. The power table spans two periods
+            (\f$pow_{i+q-1} = pow_i\f$), so that sums and differences of two
+            logarithms need not be reduced.
+         */
+        template <class E, size_t Q>
+        struct field_tables
+        {
+                E log[Q];   ///< \f$\log_g a\f$; log[0] is unused
+                E pow[2*Q]; ///< \f$g^i\f$
+        };
+
+        /// \brief GF(2^8), with the polynomial of AES
+        struct GF256
+        {
+                typedef uint8_t fq_t; ///< Element type
+                static const unsigned int size = 256;
+                static const unsigned int groupsize = 255;
+                /// \brief Irreducible polynomial of the field
+                static const unsigned int polynomial = 0x11b;
+                /// \brief Generator of the multiplicative group
+                static const unsigned int generator = 0xff;
+
+                /** \brief The tables of the field; defined constexpr in
+                    the library, so they are generated at compile time */
+                static const field_tables<fq_t, 256> tables;
+
+                /// \brief The kernels of this field in \c k
+                static const region_ops<fq_t> &region(const kernel_set &k) {
+                        return k.gf256; }
+        };
+
+        /// \brief GF(2^16)
+        struct GF65536
+        {
+                typedef uint16_t fq_t; ///< Element type
+                static const unsigned int size = 65536;
+                static const unsigned int groupsize = 65535;
+                /// \brief Irreducible polynomial of the field
+                static const unsigned int polynomial = 0x1002b;
+                /// \brief Generator of the multiplicative group
+                static const unsigned int generator = 0x8017;
+
+                /** \brief The tables of the field; defined constexpr in
+                    the library, so they are generated at compile time */
+                static const field_tables<fq_t, 65536> tables;
+
+                /// \brief The kernels of this field in \c k
+                static const region_ops<fq_t> &region(const kernel_set &k) {
+                        return k.gf65536; }
+        };
+
+        /** \brief GF(2^32)
+
+            Too large for logarithm tables: elements are multiplied as
+            polynomials over GF(2) (carry-less multiplication), and the
+            product is reduced modulo the polynomial of the field by Barrett
+            reduction. The region kernels use PCLMULQDQ where available. See
+            Field<GF2_32>.
+         */
+        struct GF2_32
+        {
+                typedef uint32_t fq_t; ///< Element type
+                static const uint64_t size = uint64_t(1) << 32;
+                static const uint32_t groupsize = 0xffffffff;
+                /// \brief Irreducible polynomial of the field:
+                /// \f$x^{32}+x^{22}+x^2+x+1\f$
+                static const uint64_t polynomial = (uint64_t(1) << 32) | 0x400007;
+                /// \brief Generator of the multiplicative group (\f$x\f$)
+                static const unsigned int generator = 2;
+                /// \brief Barrett constant: \f$\lfloor x^{64}/polynomial \rfloor\f$
+                static const uint64_t barrett = (uint64_t(1) << 32) | 0x401003;
+
+                /// \brief The kernels of this field in \c k
+                static const region_ops<fq_t> &region(const kernel_set &k) {
+                        return k.gf2_32; }
+        };
+
+        ///@}
+
+        /**
+           \brief Operations over the field described by \c F
+
+           All operations are static and inline, so that code templated on the
+           field (e.g. the matrix functions) incurs no per-symbol dispatch. The
+           functions of the same name in namespace rnc::fq operate over the
+           default field (see #Q256).
+
+           \tparam F #GF256 or #GF65536 (GF2_32 is specialized below)
+         */
+        template <class F>
+        struct Field : public F
+        {
+                typedef typename F::fq_t fq_t; ///< Element type
+
+                /// \brief \f$a*b\f$
+                static inline fq_t mul(fq_t a, fq_t b) {
+                        if (a&&b)
+                                return F::tables.pow[F::tables.log[a]
+                                                     + F::tables.log[b]];
+                        else
+                                return 0;
+                }
+                /// \brief \f$a^{-1}\f$
+                static inline fq_t inv(fq_t a) {
+                        return F::tables.pow[F::groupsize - F::tables.log[a]]; }
+                /// \brief \f$a/b\f$
+                static inline fq_t div(fq_t a, fq_t b) {
+                        if (a)
+                                return F::tables.pow[F::tables.log[a]
+                                                     + F::groupsize
+                                                     - F::tables.log[b]];
+                        else return 0;
+                }
+                /// \brief \f$a+b\f$
+                static inline fq_t add(fq_t a, fq_t b) {
+                        return a^b; }
+                /// \brief \f$a:=a*b\f$
+                static inline void mulby(fq_t& a, fq_t b) {
+                        a=mul(a, b); }
+                /// \brief \f$a:=a^{-1}\f$
+                static inline void invert(fq_t& a) {
+                        a=inv(a); }
+                /// \brief \f$a:=a/b\f$
+                static inline void divby(fq_t& a, fq_t b) {
+                        a=div(a, b); }
+                /// \brief \f$a:=a+b\f$
+                static inline void addto(fq_t& a, fq_t b) {
+                        a^=b; }
+                /// \brief \f$d:=d+(a*b)\f$
+                static inline void addto_mul(fq_t&d, fq_t a, fq_t b) {
+                        if (a&&b)
+                                d ^= F::tables.pow[F::tables.log[a]
+                                                   + F::tables.log[b]];
+                }
+
+                /// \brief \f$dst_i:=dst_i+(c*src_i)\f$ with the kernels \c k
+                static inline void addto_mul_region(const kernel_set &k,
+                                                    fq_t *dst, const fq_t *src,
+                                                    fq_t c, size_t n) {
+                        if (c) F::region(k).addto_mul(dst, src, c, n); }
+                /// \brief \f$dst_i:=c*src_i\f$ with the kernels \c k
+                static inline void mul_region(const kernel_set &k,
+                                              fq_t *dst, const fq_t *src,
+                                              fq_t c, size_t n) {
+                        F::region(k).mul(dst, src, c, n); }
+                /// \brief \f$dst_i:=dst_i+(c*src_i)\f$ with the #active_kernel
+                static inline void addto_mul_region(fq_t *dst, const fq_t *src,
+                                                    fq_t c, size_t n) {
+                        addto_mul_region(*active_kernel, dst, src, c, n); }
+                /// \brief \f$dst_i:=c*src_i\f$ with the #active_kernel
+                static inline void mul_region(fq_t *dst, const fq_t *src,
+                                              fq_t c, size_t n) {
+                        mul_region(*active_kernel, dst, src, c, n); }
+
+                /** \brief Logarithm of zero in the log domain
+
+                    The logarithms of the non-zero elements are in
+                    [0, groupsize), so groupsize is free to stand for zero.
+                 */
+                static const fq_t log_zero = F::groupsize;
+                /// \brief \f$\log_g a\f$, or #log_zero
+                static inline fq_t to_log(fq_t a) {
+                        return a ? F::tables.log[a] : log_zero; }
+                /// \brief \f$g^l\f$, or 0 for #log_zero
+                static inline fq_t from_log(fq_t l) {
+                        return l == log_zero ? 0 : F::tables.pow[l]; }
+                /** \brief \f$dst_i:=dst_i+(g^{lc}*src_i)\f$ with the
+                    #active_kernel
+
+                    Same as #addto_mul_region with the coefficient given in
+                    the log domain, which spares its logarithm lookup.
+                 */
+                static inline void addto_mul_region_log(fq_t *dst,
+                                                        const fq_t *src,
+                                                        fq_t lc, size_t n) {
+                        addto_mul_region_log(*active_kernel, dst, src, lc, n); }
+                /// \brief #addto_mul_region_log with the kernels \c k
+                static inline void addto_mul_region_log(const kernel_set &k,
+                                                        fq_t *dst,
+                                                        const fq_t *src,
+                                                        fq_t lc, size_t n) {
+                        if (lc != log_zero)
+                                F::region(k).addto_mul_log(dst, src, lc, n);
+                }
+        };
+
+        /**
+           \brief Operations over GF(2^32)
+
+           The scalar operations are portable; they are used \f$O(n^2)\f$
+           times by the matrix functions, while the region operations, used
+           \f$O(n^3)\f$ times, are bound to PCLMULQDQ kernels where
+           available.
+         */
+        template <>
+        struct Field<GF2_32> : public GF2_32
+        {
+                /// \brief Carry-less product of \c a and \c b; deg(a)+deg(b) < 64
+                static inline uint64_t clmul(uint64_t a, uint32_t b) {
+                        uint64_t p = 0;
+                        for (; b; b >>= 1, a <<= 1)
+                                if (b & 1) p ^= a;
+                        return p;
+                }
+                /// \brief Barrett reduction: \f$p \bmod polynomial\f$; deg(p) < 63
+                static inline fq_t reduce(uint64_t p) {
+                        const uint32_t q = clmul(barrett, uint32_t(p >> 32)) >> 32;
+                        return fq_t(p ^ clmul(polynomial, q));
+                }
+
+                /// \brief \f$a*b\f$
+                static inline fq_t mul(fq_t a, fq_t b) {
+                        return reduce(clmul(a, b)); }
+                /// \brief \f$a^{-1} = a^{q-2}\f$
+                static inline fq_t inv(fq_t a) {
+                        fq_t r = 1;
+                        for (uint32_t e = groupsize - 1; e; e >>= 1, a = mul(a, a))
+                                if (e & 1) r = mul(r, a);
+                        return r;
+                }
+                /// \brief \f$a/b\f$
+                static inline fq_t div(fq_t a, fq_t b) {
+                        return a ? mul(a, inv(b)) : 0; }
+                /// \brief \f$a+b\f$
+                static inline fq_t add(fq_t a, fq_t b) {
+                        return a^b; }
+                /// \brief \f$a:=a*b\f$
+                static inline void mulby(fq_t& a, fq_t b) {
+                        a=mul(a, b); }
+                /// \brief \f$a:=a^{-1}\f$
+                static inline void invert(fq_t& a) {
+                        a=inv(a); }
+                /// \brief \f$a:=a/b\f$
+                static inline void divby(fq_t& a, fq_t b) {
+                        a=div(a, b); }
+                /// \brief \f$a:=a+b\f$
+                static inline void addto(fq_t& a, fq_t b) {
+                        a^=b; }
+                /// \brief \f$d:=d+(a*b)\f$
+                static inline void addto_mul(fq_t&d, fq_t a, fq_t b) {
+                        d ^= mul(a, b); }
+
+                /// \brief \f$dst_i:=dst_i+(c*src_i)\f$ with the kernels \c k
+                static inline void addto_mul_region(const kernel_set &k,
+                                                    fq_t *dst, const fq_t *src,
+                                                    fq_t c, size_t n) {
+                        if (c) k.gf2_32.addto_mul(dst, src, c, n); }
+                /// \brief \f$dst_i:=c*src_i\f$ with the kernels \c k
+                static inline void mul_region(const kernel_set &k,
+                                              fq_t *dst, const fq_t *src,
+                                              fq_t c, size_t n) {
+                        k.gf2_32.mul(dst, src, c, n); }
+                /// \brief \f$dst_i:=dst_i+(c*src_i)\f$ with the #active_kernel
+                static inline void addto_mul_region(fq_t *dst, const fq_t *src,
+                                                    fq_t c, size_t n) {
+                        addto_mul_region(*active_kernel, dst, src, c, n); }
+                /// \brief \f$dst_i:=c*src_i\f$ with the #active_kernel
+                static inline void mul_region(fq_t *dst, const fq_t *src,
+                                              fq_t c, size_t n) {
+                        mul_region(*active_kernel, dst, src, c, n); }
+        };
+}
+}
+
+#endif //FIELD_H
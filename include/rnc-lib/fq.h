@@ -24,6 +24,8 @@
 #define FQ_H
 
 #include <config.h>
+#include <rnc-lib/field.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /// Random Network Coding Library
@@ -37,10 +39,12 @@ namespace rnc
    are implemented with offline generated power- and discrete logarithm tables.
 
    The size of the field can only be 2^8 or 2^16 (8 bit and 16 bit finite
-   fields). The 16 bit finite field is the default, as it nearly doubles the
+   fields). Both fields are available through the Field template (see
+   field.h); the functions in this namespace operate over the default field.
+   The 16 bit finite field is the default, as it nearly doubles the
    performance over fixed length blocks, and because generating a singular
    matrix in a 16 bit finite field is much less likely than in an 8 bit
-   field. The size can be set to 8 bits by defining #Q256 to 1.
+   field. The default can be set to 8 bits by defining #Q256 to 1.
  */
 namespace fq
 {
@@ -49,33 +53,40 @@ namespace fq
    \def Q256
    \brief Sets field size to 8 bits. (Default: 16 bits.)
 
-   If set to 1, the size of the finite field will be 8 bits. By default, it is
-   set to 0, in which case the field will be 16 bits. To set Q256 to 1, specify
-   \e --with-q256 when running ./configure
+   If set to 1, the size of the default finite field will be 8 bits. By
+   default, it is set to 0, in which case the field will be 16 bits. To set
+   Q256 to 1, specify \e --with-q256 when running ./configure
+
+   Only the non-templated API (fq_t, #Matrix, etc.) depends on Q256; both
+   fields can be used at the same time through Field<GF256> and
+   Field<GF65536>.
  */
 
 #if Q256 != 0
 #pragma message ( "Using 8 bit finite field (Q256)" )
-        typedef uint8_t fq_t; ///< Finite field type
+        typedef Field<GF256> default_field; ///< Field of the non-templated API
 #define fq_size 256
 #define fq_groupsize 255
 #else
 #pragma message ( "Using 16 bit finite field (Q65536)" )
-        typedef uint16_t fq_t;
+        typedef Field<GF65536> default_field;
 #define fq_size 65536
 #define fq_groupsize 65535
 #endif //Q256
 
+        typedef default_field::fq_t fq_t; ///< Finite field type
+
         /// \brief Discrete logarithm table
-        extern const fq_t * const log_table;
+        static const fq_t (&log_table)[fq_size] = default_field::tables.log;
         /// \brief Power table
-        extern const fq_t pow_table[fq_size];
+        static const fq_t (&pow_table)[2*fq_size] = default_field::tables.pow;
 
         /**
            \brief Initialize power- and logtables.
 
-           \remark \e Must be called before performing any operations.
-           \
+           \deprecated The tables are generated at compile time; this function
+           does nothing, unless the library is compiled with VERIFY_FQ, in
+           which case it verifies the field operations.
          */
         void init();
 
@@ -121,16 +132,7 @@ namespace fq
             \test 3) mul(a, mul(b, c)) == mul(mul(a, b), c) | a,b,c != 0 (trivial case)
          */
         inline fq_t mul(fq_t a, fq_t b) {
-                if (a&&b)
-                {
-                        register int t = log_table[a] + log_table[b];
-                        // === t%fq_groupsize; but this is faster.
-                        if (t>fq_groupsize) t-=fq_groupsize;
-                        return pow_table[t];
-                }
-                else
-                        return 0;
-        }
+                return default_field::mul(a, b); }
         /** \brief Multiplicative inverse over \f$\mathbb{F}_q\f$
 
          \return \f$a^{-1}\f$
@@ -138,7 +140,7 @@ namespace fq
          \test 2) 1 == mul(a, inv(a)) | a != 0
         */
         inline fq_t inv(fq_t a) {
-                return pow_table[fq_groupsize-log_table[a]]; }
+                return default_field::inv(a); }
 
         /** \brief Division over \f$\mathbb{F}_q\f$
 
@@ -146,13 +148,7 @@ namespace fq
             \test a=mul(b, div(a, b)) | b != 0
          */
         inline fq_t div(fq_t a, fq_t b) {
-                if (a) {
-                        register int t = log_table[a] - log_table[b];
-                        if (t<0) t+=fq_groupsize;
-                        return pow_table[t];
-                }
-                else return 0;
-        }
+                return default_field::div(a, b); }
 
         /** \brief Addition over \f$\mathbb{F}_q\f$
 
@@ -184,12 +180,7 @@ namespace fq
             \test t:=a; divby(t, b); t == div(a, b) | b != 0
          */
         inline void divby(fq_t& a, fq_t b) {
-                if (a) {
-                        int t = log_table[a] - log_table[b];
-                        if (t<0) t+=fq_groupsize;
-                        a = pow_table[t];
-                }
-        }
+                a=div(a, b); }
         /** \brief In-place addition over \f$\mathbb{F}_q\f$
 
             \test t:=a; addto(t, b); t == add(a, b)
@@ -205,12 +196,38 @@ namespace fq
             \test t:=d; addto_mul(t, a, b); t == add(d, mul(a, b))
          */
         inline void addto_mul(fq_t&d, fq_t a, fq_t b) {
-                if (a&&b) {
-                        int t = log_table[a] + log_table[b];
-                        if (t>fq_groupsize) t-=fq_groupsize;
-                        d ^= pow_table[t];
-                }
-        }
+                default_field::addto_mul(d, a, b); }
+
+        ///@}
+
+        /// \addtogroup fqregion Region operations over the finite field
+        /// @{
+
+        /** \brief Region multiply-add: \f$dst_i:=dst_i+(c*src_i)\f$ for
+            \f$0 \le i < n\f$.
+
+            The workhorse of matrix multiplication: a whole row is multiplied
+            by a single coefficient and added to another row. Equivalent to
+            calling #addto_mul(dst[i], c, src[i]) for each \c i, but uses
+            the vectorized kernels of #active_kernel.
+
+            \remark \c dst and \c src must not overlap, unless they are equal.
+
+            \test t:=dst; addto_mul_region(t, src, c, n); t[i] ==
+            add(dst[i], mul(c, src[i]))
+         */
+        inline void addto_mul_region(fq_t *dst, const fq_t *src, fq_t c, size_t n) {
+                default_field::addto_mul_region(dst, src, c, n); }
+
+        /** \brief Region multiplication: \f$dst_i:=c*src_i\f$ for
+            \f$0 \le i < n\f$.
+
+            \remark \c dst and \c src must not overlap, unless they are equal.
+
+            \test t:=src; mul_region(t, t, c, n); t[i] == mul(c, src[i])
+         */
+        inline void mul_region(fq_t *dst, const fq_t *src, fq_t c, size_t n) {
+                default_field::mul_region(dst, src, c, n); }
 
         ///@}
 }
@@ -27,104 +27,294 @@
 #include <rnc-lib/mt.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <vector>
 
 namespace rnc
 {
 /** \brief Matrix operations over \f$\mathbb{F}_q\f$.
+
+    The operations are templates over the field; they are instantiated in the
+    library for Field<GF256>, Field<GF65536> and Field<GF2_32>.
  */
 namespace matrix
 {
         using namespace fq;
 
-        typedef fq_t Element;
-        typedef Element *Row;
-        struct Matrix {
-                Row *rows;
+        /** \brief Matrix over the field \c Fq
+
+            The rows are stored in a single memory area, \c stride elements
+            apart. Allocated matrices are aligned to #ALIGNMENT bytes, and
+            their rows are padded to a multiple of it (see #padded_stride),
+            so that every row is aligned for the vector kernels and the whole
+            matrix can be streamed by the hardware prefetcher.
+
+            \tparam Fq Field<GF256>, Field<GF65536> or Field<GF2_32>
+         */
+        template <class Fq>
+        struct basic_matrix {
+                typedef Fq field;                    ///< The field
+                typedef typename Fq::fq_t Element;   ///< Element type
+                typedef Element *Row;                ///< Row address
+
+                /// \brief Alignment of allocated matrices and their rows
+                static const size_t ALIGNMENT = 64;
+
+                Element *data;  ///< Address of the first row
                 size_t nrows;
                 size_t ncols;
+                size_t stride;  ///< Elements from the start of a row to the next
                 bool cleanup;
 
-                Matrix(const Matrix &)
+                /** \brief Row stride of an allocated matrix of \c ncols columns
+
+                    The row size rounded up to #ALIGNMENT bytes. If that is a
+                    multiple of 512 bytes, one more cache line is added:
+                    otherwise the same column of consecutive rows would map to
+                    a few cache sets only, and evict each other.
+                 */
+                static size_t padded_stride(size_t ncols) {
+                        size_t lines = (ncols*sizeof(Element) + ALIGNMENT - 1)
+                                / ALIGNMENT;
+                        if (lines % 8 == 0 && lines > 0) ++lines;
+                        return lines * ALIGNMENT / sizeof(Element);
+                }
+
+                basic_matrix(const basic_matrix &)
                 {
                         throw std::string("Matrix object cannot be copied: not implemented.");
                 }
-                Matrix()
-                        : rows(0),
+                basic_matrix()
+                        : data(0),
                           nrows(0),
-                          ncols(0)
+                          ncols(0),
+                          stride(0),
+                          cleanup(false)
                 {}
-                Matrix(Element *memarea, size_t nrows, size_t ncols)
-                        : rows(reinterpret_cast<Row*>(malloc(sizeof(Row)*nrows))),
+                /// \brief Matrix on a contiguous, unpadded memory area
+                basic_matrix(Element *memarea, size_t nrows, size_t ncols)
+                        : data(memarea),
                           nrows(nrows),
                           ncols(ncols),
+                          stride(ncols),
                           cleanup(false)
-                {
-                        Row *r = rows;
-                        Row rowstart = reinterpret_cast<Row>(memarea);
-                        for (int i=nrows; i>0; --i, ++r, rowstart += ncols)
-                                *r = rowstart;
-                }
-                Matrix(size_t nrows, size_t ncols, bool init0 = false)
-                        : rows(reinterpret_cast<Row*>(malloc(sizeof(Row)*nrows))),
+                {}
+                /** \brief View of a block of another matrix, starting at
+                    \c memarea, with its rows \c stride elements apart */
+                basic_matrix(Element *memarea, size_t nrows, size_t ncols,
+                             size_t stride)
+                        : data(memarea),
+                          nrows(nrows),
+                          ncols(ncols),
+                          stride(stride),
+                          cleanup(false)
+                {}
+                basic_matrix(size_t nrows, size_t ncols, bool init0 = false)
+                        : data(0),
                           nrows(nrows),
                           ncols(ncols),
+                          stride(padded_stride(ncols)),
                           cleanup(true)
                 {
-                        const size_t rowsize = sizeof(Element)*ncols;
-                        Row *r = rows;
-                        for (int i=nrows; i>0; --i, ++r)
-                                if (init0)
-                                        *r = new Element[ncols]();
-                                else
-                                        *r = reinterpret_cast<Row>(malloc(rowsize));
+                        const size_t size = sizeof(Element)*nrows*stride;
+                        void *p;
+                        if (posix_memalign(&p, ALIGNMENT, size ? size : 1))
+                                throw std::string("Cannot allocate matrix.");
+                        data = reinterpret_cast<Element*>(p);
+                        if (init0) memset(data, 0, size);
                 }
-                ~Matrix()
+                ~basic_matrix()
                 {
-                        if (!rows) return;
-                        if (cleanup)
-                        {
-                                Row *r = rows;
-                                for (int i=nrows; i>0; --i, ++r)
-                                        delete [] *r;
-                        }
-                        delete [] rows;
+                        if (cleanup) free(data);
                 }
         };
 
+        /// \brief Matrix over the default field (see #Q256)
+        typedef basic_matrix<default_field> Matrix;
+        typedef Matrix::Element Element;
+        typedef Matrix::Row Row;
+
+        /// \brief Matrix over GF(2^8)
+        typedef basic_matrix<Field<GF256> > Matrix256;
+        /// \brief Matrix over GF(2^16)
+        typedef basic_matrix<Field<GF65536> > Matrix65536;
+        /** \brief Matrix over GF(2^32)
+
+            A random square matrix over GF(2^32) is singular with probability
+            below \f$2^{-31}\f$, which makes it the field of choice for large
+            generations.
+         */
+        typedef basic_matrix<Field<GF2_32> > Matrix2_32;
+
+        /** \brief Coefficient matrix over \c Fq in the log domain
+
+            Each element is stored as its discrete logarithm, zero as
+            Fq::log_zero. Multiplying by such a matrix hands the logarithms
+            to the kernels (see region_ops::prepare_log): the generic
+            kernels, which multiply by logarithms, are spared the lookup of
+            every coefficient, while the vector kernels look up the
+            coefficient instead.
+
+            Produced directly by #rand_matr and #invert, or by #to_log; only
+            the fields with logarithm tables (GF(2^8) and GF(2^16)) have it.
+
+            The storage is that of a basic_matrix, but not its type: the
+            operations over elements would take the logarithms for elements,
+            so passing a log-domain matrix to them does not compile.
+         */
+        template <class Fq>
+        struct basic_log_matrix : private basic_matrix<Fq> {
+                typedef Fq field;                    ///< The field
+                typedef typename Fq::fq_t Element;   ///< Element type
+                typedef Element *Row;                ///< Row address
+
+                using basic_matrix<Fq>::ALIGNMENT;
+                using basic_matrix<Fq>::data;
+                using basic_matrix<Fq>::nrows;
+                using basic_matrix<Fq>::ncols;
+                using basic_matrix<Fq>::stride;
+
+                basic_log_matrix(Element *memarea, size_t nrows, size_t ncols)
+                        : basic_matrix<Fq>(memarea, nrows, ncols) {}
+                basic_log_matrix(size_t nrows, size_t ncols)
+                        : basic_matrix<Fq>(nrows, ncols) {}
+        };
+
+        /// \brief Log-domain matrix over the default field (see #Q256)
+        typedef basic_log_matrix<default_field> LogMatrix;
+        /// \brief Log-domain matrix over GF(2^8)
+        typedef basic_log_matrix<Field<GF256> > LogMatrix256;
+        /// \brief Log-domain matrix over GF(2^16)
+        typedef basic_log_matrix<Field<GF65536> > LogMatrix65536;
+
+        /** \brief Sparse coefficient matrix over \c Fq, in compressed
+            sparse row (CSR) format
+
+            The non-zero elements of row \c i are <tt>val[e]</tt> in column
+            <tt>col[e]</tt> for \f$row\_start[i] \le e <
+            row\_start[i+1]\f$. Only non-zero elements are stored.
+
+            The columns of each row must be strictly ascending, i.e. sorted
+            and without duplicates, as #rand_matr fills them: the operations
+            on sparse matrices look their elements up by binary search.
+            They check it, unless NDEBUG is defined.
+
+            Coding by such a matrix (see #rand_matr with a density) costs a
+            row operation per non-zero coefficient instead of one per
+            column, in exchange for more non-innovative packets.
+         */
+        template <class Fq>
+        struct basic_sparse_matrix {
+                typedef Fq field;                    ///< The field
+                typedef typename Fq::fq_t Element;   ///< Element type
+
+                size_t nrows;
+                size_t ncols;
+                /// \brief Index of the first element of each row, and the end
+                std::vector<size_t> row_start;
+                std::vector<size_t> col;        ///< Columns of the elements
+                std::vector<Element> val;       ///< Non-zero elements
+
+                /// \brief A matrix of zeroes
+                basic_sparse_matrix(size_t nrows, size_t ncols)
+                        : nrows(nrows),
+                          ncols(ncols),
+                          row_start(nrows + 1, 0)
+                {}
+
+                /// \brief Number of non-zero elements
+                size_t nnz() const { return val.size(); }
+                /// \brief Number of non-zero elements of row \c i
+                size_t nnz(size_t i) const {
+                        return row_start[i+1] - row_start[i]; }
+        };
+
+        /// \brief Sparse matrix over the default field (see #Q256)
+        typedef basic_sparse_matrix<default_field> SparseMatrix;
+        /// \brief Sparse matrix over GF(2^8)
+        typedef basic_sparse_matrix<Field<GF256> > SparseMatrix256;
+        /// \brief Sparse matrix over GF(2^16)
+        typedef basic_sparse_matrix<Field<GF65536> > SparseMatrix65536;
+        /// \brief Sparse matrix over GF(2^32)
+        typedef basic_sparse_matrix<Field<GF2_32> > SparseMatrix2_32;
+
 #define CACHE_DIMS(m)                 \
         const size_t nrows = m.nrows; \
         const size_t ncols = m.ncols;
 
         /** \brief Number of threads to use.
 
-            Matrix multiplication will use this many threads.
+            Parallel operations (e.g. #pmul) are split into tasks, which are
+            performed by the calling thread and NCPUS-1 threads of the
+            process-wide worker pool (see rnc::pool).
 
-            The matrix will be partitioned; each partition will be processed by
-            a glib thread pool maintaining NCPUS thread.
+            Defaults to the number of CPUs online. If NCPUS is 1, the pool is
+            not used.
 
-            If NCPUS is 1, the thread pool is not created.
+            Only read when a #context is constructed: the operations without
+            a context argument use a default context.
          */
         extern int NCPUS;
         /** \brief Block size for matrix multiplication
 
-            Blocked matrix multiplication will be performed using square blocks
-            of size BLOCK_SIZE.
-
-            If BLOCK_SIZE is 1, non-blocked multiplication is performed.
+            \deprecated Not used: #mul sizes its panels by
+            context::panel_depth and context::panel_bytes instead. Kept so
+            that code setting it still compiles.
          */
         extern int BLOCK_SIZE;
 
+        /** \brief Settings of a matrix operation
+
+            Passed to an operation by the caller, so that concurrent sessions
+            can use their own settings without any shared mutable state. The
+            operations without a context argument construct a default one on
+            entry.
+         */
+        struct context
+        {
+                int ncpus;                 ///< Threads to use; see #NCPUS
+                /** \brief Rows of the right-hand side matrix (columns of the
+                    coefficients) combined per pass of #mul */
+                size_t panel_depth;
+                /** \brief Width of the panels of #mul, in bytes; a panel of
+                    panel_depth rows should stay in the L2 cache while it is
+                    reused for every row of the result. */
+                size_t panel_bytes;
+                /** \brief Bytes of the right-hand side matrix read by a tile
+                    of #pmul; it should stay in the cache while it is reused
+                    for every row of the tile. */
+                size_t tile_panel_bytes;
+                /** \brief Minimum width of a tile of #pmul, in bytes; every
+                    row operation sets up the tables of its coefficient, which
+                    must be amortized over a long enough row. */
+                size_t tile_min_row_bytes;
+                /** \brief Columns eliminated per step of #invert; larger
+                    matrices are inverted by blocks, see #invert_rank */
+                size_t invert_block;
+                const kernel_set *kernel;  ///< Region kernels to use
+
+                /** \brief The default context: #NCPUS and the
+                    #active_kernel at the time of construction */
+                context()
+                        : ncpus(NCPUS),
+                          panel_depth(64),
+                          panel_bytes(16*1024),
+                          tile_panel_bytes(4*1024*1024),
+                          tile_min_row_bytes(32*1024),
+                          invert_block(64),
+                          kernel(active_kernel)
+                {}
+        };
+
         /// \addtogroup matr Matrix functions
         /// @{
 
         /// \addtogroup matr_e Element access
-        /// \warning These will change after the matrix representation has
-        /// changed \sa mul
         /// @{
 
 /// \brief  Row address
-#define RA(m,r)   (*((m.rows)+(r)))
+#define RA(m,r)   ((m).data + (r)*(m).stride)
 /// \brief  Row element
 #define RE(ra, c) (*((ra) + (c)))
 /// \brief  Address
@@ -138,27 +328,105 @@ namespace matrix
         /// @{
 
         /** \brief Initialize a matrix to identity. */
-        void set_identity(Matrix &m) throw();
+        template <class Fq>
+        void set_identity(basic_matrix<Fq> &m) throw();
         /** \brief Initialize a matrix with zeroes. */
-        void set_zero(Matrix &m) throw();
+        template <class Fq>
+        void set_zero(basic_matrix<Fq> &m) throw();
         /** \brief Copy a matrix
             @param m Matrix to be copied
             @param md Destination matrix
          */
-        void copy(const Matrix &m, Matrix &md) throw();
+        template <class Fq>
+        void copy(const basic_matrix<Fq> &m, basic_matrix<Fq> &md) throw();
         /** \brief Copy a matrix to a contiguous memory area
             @param m Matrix to be copied
             @param md Destination address
          */
-        void copy(const Matrix &m, Element* dest) throw();
+        template <class Fq>
+        void copy(const basic_matrix<Fq> &m,
+                  typename basic_matrix<Fq>::Element* dest) throw();
         /** \brief Invert a matrix
 
             @param m_in Matrix to be inverted
             @param res Result address
 
+            \return false, iff \c m_in is singular; see #invert_rank.
+            \throw std::string As #invert_rank.
+
             \test A = mul(A, mul(A, invert(A))) | \f$\exists A^{-1}\f$
         */
-        bool invert(const Matrix &m_in, Matrix &res) throw ();
+        template <class Fq>
+        bool invert(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res);
+        /// \brief #invert with the kernels of \c ctx
+        template <class Fq>
+        bool invert(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res,
+                    const context &ctx);
+        /** \brief Invert a matrix, or find its rank if it is singular
+
+            Gauss-Jordan elimination with row pivoting, so it succeeds on
+            every invertible matrix.
+
+            Matrices larger than context::invert_block are eliminated a
+            block of columns at a time: the pivots of the block are found on
+            a copy of its columns, the pivot rows are normalized in place
+            from the factorization of their pivot block, and then the pivot
+            columns are eliminated from all the other rows by a single
+            matrix multiplication, which is split into tiles on the worker
+            pool as by #pmul.
+
+            @param m_in Square matrix to be inverted
+            @param res Result address; undefined if \c m_in is singular
+            @param dependent If not 0, receives the indices of the rows of \c
+            m_in that are linear combinations of the rows not listed (none,
+            if \c m_in is invertible). The rows not listed are independent,
+            so replacing just the listed ones with random rows makes \c m_in
+            invertible with high probability.
+
+            \return The rank of \c m_in
+            \throw std::string If a work matrix cannot be allocated, or the
+            worker pool cannot be created.
+         */
+        template <class Fq>
+        size_t invert_rank(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res,
+                           std::vector<size_t> *dependent);
+        /// \brief #invert_rank with the kernels of \c ctx
+        template <class Fq>
+        size_t invert_rank(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res,
+                           std::vector<size_t> *dependent,
+                           const context &ctx);
+        /** \brief Decode coded data in place: solve \f$coefs*x=data\f$
+
+            Gauss-Jordan elimination on the augmented system
+            \f$[coefs|data]\f$, without the inverse of \c coefs nor a
+            temporary as large as \c data. \c coefs is factorized first,
+            and its row operations are then replayed on \c data in place,
+            by tiles of columns that stay in the cache, on the worker pool.
+            Above context::invert_block columns, they are eliminated by
+            blocks as in #invert_rank, so that the data are updated by
+            accumulating matrix products rather than row by row.
+
+            @param coefs Coefficients of the coded rows: at least as many
+            rows as columns (sources). Overwritten.
+            @param data Coded rows, as many as the rows of \c coefs. If the
+            rank is full, its first \c coefs.ncols rows are overwritten with
+            the decoded sources; the others are left undefined.
+            @param dependent If not 0, receives the indices of the rows that
+            are linear combinations of the others, as with #invert_rank.
+            They are the redundant rows when \c coefs is tall.
+
+            \return The rank of \c coefs; the data are decoded iff it equals
+            \c coefs.ncols.
+            \throw std::string As #invert_rank.
+         */
+        template <class Fq>
+        size_t decode(basic_matrix<Fq> &coefs, basic_matrix<Fq> &data,
+                      std::vector<size_t> *dependent = 0);
+        /// \brief #decode with the kernels of \c ctx
+        template <class Fq>
+        size_t decode(basic_matrix<Fq> &coefs, basic_matrix<Fq> &data,
+                      std::vector<size_t> *dependent,
+                      const context &ctx);
 
         // (rows1 x cols1) * (cols1 x cols2) = (rows1 x cols2)
         /** \brief Matrix multiplication: \f$md:=m1*m2\f$
@@ -183,20 +451,39 @@ namespace matrix
             \remark \c md must point to an address capable of storing \c rows1 x
             \c cols2 elements.
 
-            \todo Use another matrix representation: store each row separately,
-            each row is pointed to by pointer, the vector/array of these pointer
-            is passed as input (instead of storing the whole matrix in a single
-            line).
+            The product is computed panel by panel: the non-zero coefficients
+            of a block of context::panel_depth columns of \c m1 are packed
+            with their prepared product tables (see
+            rnc::fq::region_ops::prepare), and a microkernel adds several rows
+            of \c m2 to a row of the result at once, over a window of
+            context::panel_bytes, so that the rows of \c m2 in the window stay
+            in the cache for every row of the result.
          */
-        void mul(const Matrix &m1, const Matrix &m2, Matrix &md);
+        template <class Fq>
+        void mul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                 basic_matrix<Fq> &md);
+        /// \brief #mul with the settings of \c ctx
+        template <class Fq>
+        void mul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                 basic_matrix<Fq> &md, const context &ctx);
         /** \brief Parallelized version of #mul.
 
-            If NCPUS is 1, this function will simply call #mul.
+            The number of threads is context::ncpus of the context used
+            (#NCPUS by default). If it is 1, the product is computed as by
+            #mul on the calling thread.
 
-            If NCPUS is greater than 1, this function will spawn NCPUS threads
-            to perform the multiplication.
+            Otherwise the result is split into 2D tiles, a few per thread,
+            each computed as by #mul; the calling thread and the threads of
+            the worker pool (see rnc::pool::run) claim them until none is
+            left.
          */
-        void pmul(const Matrix &m1, const Matrix &m2, Matrix &md);
+        template <class Fq>
+        void pmul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                  basic_matrix<Fq> &md);
+        /// \brief #pmul with the settings of \c ctx
+        template <class Fq>
+        void pmul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                  basic_matrix<Fq> &md, const context &ctx);
 
         /** \brief Generates a random matrix.
 
@@ -205,7 +492,225 @@ namespace matrix
             @param rows Number of rows
             @param cols Number of columns
          */
-        void rand_matr(Matrix &m, random::mt_state *rnd_state);
+        template <class Fq>
+        void rand_matr(basic_matrix<Fq> &m, random::mt_state *rnd_state);
+
+        /// @}
+
+        /// \addtogroup matr_batch Operations on batches of generations
+        /// @{
+
+        /// \brief A product of a batch: \f$md:=m1*m2\f$, see #pmul_batch
+        template <class Fq>
+        struct mul_job {
+                const basic_matrix<Fq> *m1;
+                const basic_matrix<Fq> *m2;
+                basic_matrix<Fq> *md;
+        };
+
+        /// \brief A decoding of a batch, see #decode_batch
+        template <class Fq>
+        struct decode_job {
+                basic_matrix<Fq> *coefs;         ///< As with #decode
+                basic_matrix<Fq> *data;          ///< As with #decode
+                std::vector<size_t> *dependent;  ///< As with #decode, or 0
+                size_t rank;                     ///< Result of #decode
+        };
+
+        /** \brief #pmul of many independent generations as a single
+            operation
+
+            A large object is coded as many small generations: multiplying
+            them one by one leaves the threads idle at the end of each, as
+            a small product cannot be split into enough tiles. Here the
+            tiles of all the products are distributed at once: each product
+            is a single tile if there are enough of them, and is split
+            into tiles of columns as by #pmul otherwise.
+         */
+        template <class Fq>
+        void pmul_batch(const std::vector<mul_job<Fq> > &batch);
+        /// \brief #pmul_batch with the settings of \c ctx
+        template <class Fq>
+        void pmul_batch(const std::vector<mul_job<Fq> > &batch,
+                        const context &ctx);
+        /** \brief #decode of many independent generations as a single
+            operation
+
+            If there are at least as many generations as threads, each
+            generation is decoded by a single thread, the generations being
+            distributed among the threads of the pool. Otherwise they are
+            decoded one by one, each by all the threads as by #decode.
+         */
+        template <class Fq>
+        void decode_batch(std::vector<decode_job<Fq> > &batch);
+        /// \brief #decode_batch with the settings of \c ctx
+        template <class Fq>
+        void decode_batch(std::vector<decode_job<Fq> > &batch,
+                          const context &ctx);
+        /** \brief #invert of many small square matrices at once
+
+            \c m holds the \f$m.nrows / m.ncols\f$ matrices one above the
+            other, matrix \c b being rows \f$[b*n, (b+1)*n)\f$ where
+            \f$n = m.ncols\f$; their inverses are stored in the same rows
+            of \c res, which may be \c m. If \c m.nrows is not a multiple
+            of \c n, the rows left below the last matrix are ignored, and
+            the same rows of \c res are not changed.
+
+            A small matrix is too narrow for the region kernels: the
+            matrices are instead interleaved by groups, each element of a
+            SIMD vector belonging to another matrix of the group, and
+            eliminated together. Beyond the size where #invert of each
+            matrix is faster (12 to 48 rows, depending on the field), the
+            matrices are inverted one by one instead. Either way, the work
+            is split among the threads of the pool, and the work areas are
+            allocated once per thread, not per matrix.
+
+            \param singular If not null, the indices of the singular
+            matrices are appended to it; their rows of \c res are undefined.
+            \return The number of matrices inverted.
+            \throw std::string As #invert_rank.
+         */
+        template <class Fq>
+        size_t invert_batch(const basic_matrix<Fq> &m, basic_matrix<Fq> &res,
+                            std::vector<size_t> *singular = 0);
+        /// \brief #invert_batch with the settings of \c ctx
+        template <class Fq>
+        size_t invert_batch(const basic_matrix<Fq> &m, basic_matrix<Fq> &res,
+                            std::vector<size_t> *singular,
+                            const context &ctx);
+
+        /// @}
+
+        /// \addtogroup matr_log Operations in the log domain
+        /// @{
+
+        /** \brief Initialize a log-domain matrix to identity. */
+        template <class Fq>
+        void set_identity(basic_log_matrix<Fq> &m) throw();
+        /** \brief Initialize a log-domain matrix with zeroes. */
+        template <class Fq>
+        void set_zero(basic_log_matrix<Fq> &m) throw();
+        /** \brief Convert a matrix to the log domain: \f$md:=\log_g m\f$ */
+        template <class Fq>
+        void to_log(const basic_matrix<Fq> &m, basic_log_matrix<Fq> &md) throw();
+        /** \brief Convert a matrix from the log domain: \f$md:=g^m\f$ */
+        template <class Fq>
+        void from_log(const basic_log_matrix<Fq> &m, basic_matrix<Fq> &md) throw();
+        /** \brief Invert a matrix, storing the result in the log domain
+
+            The elimination itself is performed on the elements; only the
+            result is converted, so that it can be used by #mul directly.
+         */
+        template <class Fq>
+        bool invert(const basic_matrix<Fq> &m_in,
+                    basic_log_matrix<Fq> &res);
+        template <class Fq>
+        bool invert(const basic_matrix<Fq> &m_in,
+                    basic_log_matrix<Fq> &res, const context &ctx);
+        /** \brief Invert a log-domain matrix */
+        template <class Fq>
+        bool invert(const basic_log_matrix<Fq> &m_in,
+                    basic_log_matrix<Fq> &res);
+        template <class Fq>
+        bool invert(const basic_log_matrix<Fq> &m_in,
+                    basic_log_matrix<Fq> &res, const context &ctx);
+        /** \brief Matrix multiplication by a log-domain coefficient matrix:
+            \f$md:=m1*m2\f$
+
+            Same as #mul over elements, but the coefficients are prepared
+            from their logarithms, see region_ops::prepare_log.
+         */
+        template <class Fq>
+        void mul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                 basic_matrix<Fq> &md);
+        template <class Fq>
+        void mul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                 basic_matrix<Fq> &md, const context &ctx);
+        /** \brief Parallelized version of #mul by a log-domain matrix. */
+        template <class Fq>
+        void pmul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                  basic_matrix<Fq> &md);
+        template <class Fq>
+        void pmul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                  basic_matrix<Fq> &md, const context &ctx);
+        /** \brief Generates a random matrix in the log domain
+
+            The elements are uniform over the field, as with #rand_matr over
+            elements; their logarithms are drawn directly.
+         */
+        template <class Fq>
+        void rand_matr(basic_log_matrix<Fq> &m, random::mt_state *rnd_state);
+
+        /// @}
+
+        /// \addtogroup matr_sparse Operations on sparse matrices
+        /// @{
+
+        /** \brief Convert a sparse matrix to a dense one: \f$md:=m\f$ */
+        template <class Fq>
+        void copy(const basic_sparse_matrix<Fq> &m,
+                  basic_matrix<Fq> &md) throw();
+        /** \brief Matrix multiplication by a sparse coefficient matrix:
+            \f$md:=m1*m2\f$
+
+            Same as #mul, but only the non-zero elements of \c m1 are
+            visited: each row is packed whole, instead of by
+            context::panel_depth columns, so the panel kernels combine as
+            many rows of \c m2 at once as a row of \c m1 has non-zero
+            elements.
+         */
+        template <class Fq>
+        void mul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                 basic_matrix<Fq> &md);
+        template <class Fq>
+        void mul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                 basic_matrix<Fq> &md, const context &ctx);
+        /** \brief Parallelized version of #mul by a sparse matrix. */
+        template <class Fq>
+        void pmul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                  basic_matrix<Fq> &md);
+        template <class Fq>
+        void pmul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+                  basic_matrix<Fq> &md, const context &ctx);
+        /** \brief Generates a random sparse matrix
+
+            Each element is non-zero with probability \c density, uniform
+            over the non-zero elements of the field if so. A row that would
+            be empty gets a single non-zero element in a random column.
+         */
+        template <class Fq>
+        void rand_matr(basic_sparse_matrix<Fq> &m, double density,
+                       random::mt_state *rnd_state);
+        /** \brief Decode coded data by a sparse coefficient matrix
+
+            Same as #decode, in an order that preserves the sparsity of \c
+            coefs. First the rows with a single unknown left are solved and
+            substituted into the others, repeatedly (peeling); this creates
+            no fill-in, and costs a row operation on the data per non-zero
+            element. The rows and unknowns left form a smaller, denser system,
+            which is decoded by #decode.
+
+            @param coefs Coefficients of the coded rows, at least as many
+            rows as columns; not changed
+            @param data Coded rows, as many as the rows of \c coefs. If the
+            rank is full, its first \c coefs.ncols rows are overwritten with
+            the decoded sources; the others are left undefined.
+            @param dependent If not 0, receives the indices of the rows that
+            are linear combinations of the others, in ascending order
+
+            \return The rank of \c coefs
+            \throw std::string As #invert_rank.
+         */
+        template <class Fq>
+        size_t decode(const basic_sparse_matrix<Fq> &coefs,
+                      basic_matrix<Fq> &data,
+                      std::vector<size_t> *dependent = 0);
+        /// \brief #decode by a sparse matrix with the kernels of \c ctx
+        template <class Fq>
+        size_t decode(const basic_sparse_matrix<Fq> &coefs,
+                      basic_matrix<Fq> &data,
+                      std::vector<size_t> *dependent,
+                      const context &ctx);
 
         /// @} @}
 }
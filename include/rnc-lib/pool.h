@@ -0,0 +1,78 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Process-wide worker pool of the parallel operations
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+namespace rnc
+{
+/** \brief Worker threads shared by the parallel operations (e.g.
+    matrix::pmul)
+
+    The threads are started on first use and kept until #shutdown, so that
+    an operation on a small matrix does not pay for spawning and joining
+    them. The pool grows to the largest number of threads requested by an
+    operation (see matrix::context::ncpus).
+ */
+namespace pool
+{
+        /// \brief A task: the \c i th piece of an operation on \c data
+        typedef void (*task_fn)(size_t i, void *data);
+
+        /** \brief Number of CPUs online; the default of matrix::NCPUS */
+        int cpu_count();
+
+        /** \brief Performs \c task(i, data) for every \f$0 \le i < n\f$
+
+            The tasks are distributed among \c nthreads threads: the caller
+            and nthreads-1 workers of the pool. Each of them starts on its own
+            contiguous range of tasks, and steals half of the remaining range
+            of another one when done, so that neighbouring tasks tend to run
+            on the same thread and stragglers are relieved. Returns when all
+            tasks are done. If \c nthreads is 1, or there is a single task,
+            the pool is not used.
+
+            \c n must be below \f$2^{32}\f$.
+
+            Can be called from several threads at the same time, but not from
+            within a task.
+
+            If a task throws, the tasks not started yet are skipped, and the
+            first exception is rethrown once the tasks running are done.
+
+            \throw std::string If the pool cannot be created.
+         */
+        void run(task_fn task, void *data, size_t n, int nthreads);
+
+        /** \brief Stops the worker threads
+
+            The pool is started again by the next #run.
+
+            \remark Must not be called while an operation is running.
+         */
+        void shutdown();
+}
+}
+
+#endif //POOL_H
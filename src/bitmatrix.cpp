@@ -0,0 +1,284 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Implementation of the GF(2) operations specified in
+    rnc-lib/bitmatrix.h
+ */
+
+#include <rnc-lib/bitmatrix.h>
+#include <rnc-lib/matrix.h>
+#include <rnc-lib/pool.h>
+#include <string.h>
+#include <algorithm>
+
+namespace rnc
+{
+namespace matrix
+{
+
+typedef BitMatrix::Word word_t;
+
+/** \brief Width of the column strips of #mul, in words
+
+    A table of the Four Russians has at most 256 rows of this width: 64 KiB.
+ */
+static const size_t STRIP_WORDS = 32;
+
+/// \brief \f$d:=d+s\f$ over \c n words
+static inline void xor_row(word_t *d, const word_t *s, size_t n)
+{
+        for (size_t i=0; i<n; ++i)
+                d[i] ^= s[i];
+}
+
+/// \brief \c k (at most 8) elements of row \c r, starting at column \c c
+static inline unsigned int get_bits(const word_t *r, size_t c, unsigned int k)
+{
+        const size_t w = c / 64, off = c % 64;
+        word_t bits = r[w] >> off;
+        if (off + k > 64) bits |= r[w+1] << (64 - off);
+        return bits & ((word_t(1) << k) - 1);
+}
+
+/** \brief Rows per group of the Four Russians
+
+    The table of a group costs \f$2^k\f$ row additions, and saves \f$k/2\f$
+    row additions for each of the \c n rows it is used for: \f$k \approx
+    \log_2 n\f$, but at most 8.
+ */
+static unsigned int group_size(size_t n)
+{
+        unsigned int k = 1;
+        while (k < 8 && (size_t(2) << k) <= n) ++k;
+        return k;
+}
+
+/** \brief Tabulates the combinations of the rows \c src[0..k)
+
+    \c t[v] is the sum of the rows \c src[j] for the bits \c j set in \c
+    v, over the words [w0, w1) of the rows.
+ */
+static void make_table(word_t *t, word_t * const *src, unsigned int k,
+                       size_t w0, size_t w1)
+{
+        const size_t w = w1 - w0;
+        memset(t, 0, w*sizeof(word_t));
+        for (size_t v=1; v < (size_t(1) << k); ++v)
+        {
+                unsigned int j = 0;
+                while (!(v & (size_t(1) << j))) ++j;
+
+                word_t *d = t + v*w;
+                memcpy(d, t + (v & (v-1))*w, w*sizeof(word_t));
+                xor_row(d, src[j] + w0, w);
+        }
+}
+
+void set_identity(BitMatrix &m) throw()
+{
+        set_zero(m);
+        const size_t n = std::min(m.nrows, m.ncols);
+        for (size_t i=0; i<n; ++i)
+                m.set(i, i, true);
+}
+
+void set_zero(BitMatrix &m) throw()
+{
+        for (size_t i=0; i<m.nrows; ++i)
+                memset(m.rows[i], 0, m.nwords*sizeof(word_t));
+}
+
+void copy(const BitMatrix &m, BitMatrix &md) throw()
+{
+        for (size_t i=0; i<m.nrows; ++i)
+                memcpy(md.rows[i], m.rows[i], m.nwords*sizeof(word_t));
+}
+
+bool invert(const BitMatrix &m, BitMatrix &res)
+{
+        const size_t n = m.nrows;
+        const size_t aw = m.nwords;
+
+        // Augmented matrix [m | I]; the halves are word-aligned
+        BitMatrix w(n, 2*aw*64);
+        for (size_t i=0; i<n; ++i)
+        {
+                memcpy(w.rows[i], m.rows[i], aw*sizeof(word_t));
+                w.rows[i][aw + i/64] |= word_t(1) << (i%64);
+        }
+
+        const unsigned int k0 = group_size(n);
+        word_t * const table = new word_t[(size_t(1) << k0) * 2*aw];
+        bool retval = true;
+
+        for (size_t c0=0; c0<n && retval; c0+=k0)
+        {
+                const unsigned int k = std::min<size_t>(k0, n-c0);
+                // Columns before c0 are zero in the rows from c0 on
+                const size_t w0 = c0 / 64;
+                const size_t width = 2*aw - w0;
+
+                // Pivots of columns [c0, c0+k) into rows [c0, c0+k), reduced
+                // to the identity on these columns
+                for (unsigned int j=0; j<k; ++j)
+                {
+                        const size_t col = c0 + j;
+                        size_t r = col;
+                        for (; r<n; ++r)
+                        {
+                                word_t *row = w.rows[r];
+                                for (unsigned int p=0; p<j; ++p)
+                                        if (w.get(r, c0+p))
+                                                xor_row(row + w0,
+                                                        w.rows[c0+p] + w0,
+                                                        width);
+                                if (w.get(r, col)) break;
+                        }
+                        if (r == n)
+                        {
+                                retval = false;
+                                break;
+                        }
+                        std::swap(w.rows[r], w.rows[col]);
+
+                        for (unsigned int p=0; p<j; ++p)
+                                if (w.get(c0+p, col))
+                                        xor_row(w.rows[c0+p] + w0,
+                                                w.rows[col] + w0, width);
+                }
+                if (!retval) break;
+
+                // Clear the columns in all the other rows
+                make_table(table, w.rows + c0, k, w0, 2*aw);
+                for (size_t i=0; i<n; ++i)
+                {
+                        if (i >= c0 && i < c0+k) continue;
+                        const unsigned int b = get_bits(w.rows[i], c0, k);
+                        if (b) xor_row(w.rows[i] + w0, table + b*width, width);
+                }
+        }
+
+        if (retval)
+                for (size_t i=0; i<n; ++i)
+                        memcpy(res.rows[i], w.rows[i] + aw, aw*sizeof(word_t));
+
+        delete [] table;
+        return retval;
+}
+
+/// \brief \f$md:=m1*m2\f$ over the words [w0, w1) of the rows of m2 and md
+static void mul_strip(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md,
+                      size_t w0, size_t w1, word_t *table)
+{
+        const size_t w = w1 - w0;
+        const unsigned int k0 = group_size(m1.nrows);
+
+        for (size_t i=0; i<md.nrows; ++i)
+                memset(md.rows[i] + w0, 0, w*sizeof(word_t));
+
+        for (size_t c=0; c<m1.ncols; c+=k0)
+        {
+                const unsigned int k = std::min<size_t>(k0, m1.ncols-c);
+                make_table(table, m2.rows + c, k, w0, w1);
+                for (size_t i=0; i<m1.nrows; ++i)
+                {
+                        const unsigned int b = get_bits(m1.rows[i], c, k);
+                        if (b) xor_row(md.rows[i] + w0, table + b*w, w);
+                }
+        }
+}
+
+/// \brief \f$md:=m1*m2\f$ over the words [w0, w1), strip by strip
+static void mul_range(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md,
+                      size_t w0, size_t w1)
+{
+        word_t * const table =
+                new word_t[(size_t(1) << group_size(m1.nrows)) * STRIP_WORDS];
+        for (size_t s=w0; s<w1; s+=STRIP_WORDS)
+                mul_strip(m1, m2, md, s, std::min(s+STRIP_WORDS, w1), table);
+        delete [] table;
+}
+
+void mul(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md)
+{
+        mul_range(m1, m2, md, 0, m2.nwords);
+}
+
+/// \brief Data of the threads of #pmul
+typedef struct bitmuldata
+{
+        /// \brief Left-hand side matrix
+        const BitMatrix &m1;
+        /// \brief Right-hand side matrix
+        const BitMatrix &m2;
+        /// \brief Result address
+        BitMatrix &md;
+        /// \brief Words per task
+        size_t chunk;
+} bitmuldata;
+
+static void mulchunk(size_t chunk, void *d)
+{
+        const bitmuldata *data = reinterpret_cast<bitmuldata*>(d);
+        const size_t w0 = chunk * data->chunk;
+        mul_range(data->m1, data->m2, data->md, w0,
+                  std::min(w0 + data->chunk, data->m2.nwords));
+}
+
+void pmul(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md)
+{
+        pmul(m1, m2, md, context());
+}
+
+void pmul(const BitMatrix &m1, const BitMatrix &m2, BitMatrix &md,
+          const context &ctx)
+{
+        const size_t nwords = m2.nwords;
+        if (ctx.ncpus == 1 || nwords <= STRIP_WORDS)
+        {
+                mul(m1, m2, md);
+                return;
+        }
+
+        // A few tasks per thread, each a whole number of strips
+        const size_t nstrips = (nwords + STRIP_WORDS - 1) / STRIP_WORDS;
+        const size_t ntasks = std::min<size_t>(nstrips, 4*size_t(ctx.ncpus));
+        const size_t chunk =
+                (nstrips + ntasks - 1) / ntasks * STRIP_WORDS;
+        bitmuldata d = { m1, m2, md, chunk };
+
+        pool::run(mulchunk, &d, (nwords + chunk - 1) / chunk, ctx.ncpus);
+}
+
+void rand_matr(BitMatrix &m, random::mt_state *rnd_state)
+{
+        const size_t tail = m.ncols % 64;
+        for (size_t i=0; i<m.nrows; ++i)
+        {
+                word_t *row = m.rows[i];
+                for (size_t j=0; j<m.nwords; ++j)
+                        row[j] = (word_t(random::generate(rnd_state)) << 32)
+                                | random::generate(rnd_state);
+                if (tail)
+                        row[m.nwords-1] &= (word_t(1) << tail) - 1;
+        }
+}
+
+}
+}
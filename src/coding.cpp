@@ -0,0 +1,405 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Implementation of the coders specified in rnc-lib/coding.h
+ */
+
+#include <rnc-lib/coding.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+namespace rnc
+{
+namespace coding
+{
+
+template <class Fq>
+void seed_coefficients(random::random_type seed,
+                       typename Fq::fq_t *coefs, size_t n)
+{
+        random::mt_state state;
+        state.mat1 = 0x8f7011ee;
+        state.mat2 = 0xfc78ff1f;
+        state.tmat = 0x3793fdff;
+        random::init(&state, seed);
+
+        for (size_t c=0; c<n; ++c)
+                coefs[c] = typename Fq::fq_t(random::generate(&state));
+}
+
+template <class Fq>
+basic_encoder<Fq>::basic_encoder(const Matrix &sources, const context &ctx)
+        : _sources(sources),
+          _ctx(ctx),
+          _depth(std::min(std::max<size_t>(ctx.panel_depth, 1),
+                          std::max<size_t>(sources.nrows, 1))),
+          _prep((_depth*Fq::region(*ctx.kernel).prepared_size + 7) / 8),
+          _src(_depth),
+          _seeded(sources.nrows)
+{}
+
+template <class Fq>
+void basic_encoder<Fq>::encode(const Element *coefs, Element *payload)
+{
+        const size_t n = size();
+        const size_t ncols = _sources.ncols;
+        const region_ops<Element> &ops = Fq::region(*_ctx.kernel);
+
+        memset(payload, 0, ncols*sizeof(Element));
+        for (size_t k=0; k<n; k+=_depth)
+        {
+                const size_t lk = std::min(k + _depth, n);
+                size_t count = 0;
+                for (size_t c=k; c<lk; ++c)
+                {
+                        if (!coefs[c]) continue;
+                        ops.prepare(reinterpret_cast<char*>(&_prep[0])
+                                    + count*ops.prepared_size, coefs[c]);
+                        _src[count++] = RA(_sources, c);
+                }
+                if (count)
+                        ops.addto_mul_panel(payload, &_src[0], 0, &_prep[0],
+                                            count, ncols);
+        }
+}
+
+template <class Fq>
+void basic_encoder<Fq>::encode(random::mt_state *rnd_state,
+                               Element *coefs, Element *payload)
+{
+        for (size_t c=0; c<size(); ++c)
+                coefs[c] = Element(random::generate(rnd_state));
+        encode(coefs, payload);
+}
+
+template <class Fq>
+void basic_encoder<Fq>::encode(random::random_type seed, Element *payload)
+{
+        seed_coefficients<Fq>(seed, &_seeded[0], size());
+        encode(&_seeded[0], payload);
+}
+
+template <class Fq>
+basic_decoder<Fq>::basic_decoder(size_t n, size_t ncols, const context &ctx)
+        : _ctx(ctx),
+          _coefs(n, n, true),
+          _data(n, ncols, true),
+          _pivot(n, 0),
+          _unit(n, 0),
+          _rank(0),
+          _v(n),
+          _prep((n*Fq::region(*ctx.kernel).prepared_size + 7) / 8),
+          _src(n)
+{}
+
+template <class Fq>
+bool basic_decoder<Fq>::add(const Element *coefs, const Element *payload)
+{
+        memcpy(&_v[0], coefs, size()*sizeof(Element));
+        return insert(payload);
+}
+
+template <class Fq>
+bool basic_decoder<Fq>::add(random::random_type seed, const Element *payload)
+{
+        seed_coefficients<Fq>(seed, &_v[0], size());
+        return insert(payload);
+}
+
+template <class Fq>
+bool basic_decoder<Fq>::insert(const Element *payload)
+{
+        const size_t n = size();
+        const size_t ncols = _data.ncols;
+        const kernel_set &k = *_ctx.kernel;
+        const region_ops<Element> &ops = Fq::region(k);
+        Element * const v = &_v[0];
+
+        // The rows are reduced, so the multiplier of row c is coefficient c
+        // of the packet as received: the other rows are 0 in column c, and
+        // leave it unchanged.
+        size_t count = 0;
+        for (size_t c=0; c<n; ++c)
+        {
+                const Element h = v[c];
+                if (!_pivot[c] || !h) continue;
+
+                if (_unit[c])
+                        v[c] = 0;
+                else
+                        Fq::addto_mul_region(k, v, RA(_coefs, c), h, n);
+                ops.prepare(reinterpret_cast<char*>(&_prep[0])
+                            + count*ops.prepared_size, h);
+                _src[count++] = RA(_data, c);
+        }
+
+        size_t p = 0;
+        while (p < n && !v[p]) ++p;
+        if (p == n) return false;
+        size_t q = p + 1;
+        while (q < n && !v[q]) ++q;
+
+        Element * const row = RA(_coefs, p);
+        Element * const prow = RA(_data, p);
+        const Element pinv = Fq::inv(v[p]);
+        Fq::mul_region(k, row, v, pinv, n);
+        memcpy(prow, payload, ncols*sizeof(Element));
+        if (count)
+                ops.addto_mul_panel(prow, &_src[0], 0, &_prep[0], count,
+                                    ncols);
+        Fq::mul_region(k, prow, prow, pinv, ncols);
+
+        _unit[p] = q == n;
+        clear(p);
+        _pivot[p] = 1;
+        ++_rank;
+        return true;
+}
+
+template <class Fq>
+bool basic_decoder<Fq>::add_source(size_t i, const Element *payload)
+{
+        const size_t n = size();
+        if (_pivot[i])
+        {
+                // Row i may still combine other sources
+                if (_unit[i]) return false;
+                memset(&_v[0], 0, n*sizeof(Element));
+                _v[i] = 1;
+                return insert(payload);
+        }
+
+        // e_i is 0 in the pivot columns of the other rows: reduced already
+        Element * const row = RA(_coefs, i);
+        memset(row, 0, n*sizeof(Element));
+        row[i] = 1;
+        memcpy(RA(_data, i), payload, _data.ncols*sizeof(Element));
+
+        _unit[i] = 1;
+        clear(i);
+        _pivot[i] = 1;
+        ++_rank;
+        return true;
+}
+
+template <class Fq>
+void basic_decoder<Fq>::clear(size_t p)
+{
+        const size_t n = size();
+        const size_t ncols = _data.ncols;
+        const kernel_set &k = *_ctx.kernel;
+        const Element * const row = RA(_coefs, p);
+        const Element * const prow = RA(_data, p);
+
+        for (size_t r=0; r<n; ++r)
+        {
+                if (!_pivot[r] || r == p) continue;
+                const Element h = E(_coefs, r, p);
+                if (!h) continue;
+
+                if (_unit[p])
+                        E(_coefs, r, p) = 0;
+                else
+                        Fq::addto_mul_region(k, RA(_coefs, r), row, h, n);
+                Fq::addto_mul_region(k, RA(_data, r), prow, h, ncols);
+        }
+}
+
+template <class Fq>
+bool basic_decoder<Fq>::decoded(size_t i) const
+{
+        if (!_pivot[i]) return false;
+        if (_unit[i]) return true;
+
+        const Element *row = RA(_coefs, i);
+        for (size_t c=0; c<size(); ++c)
+                if (c != i && row[c]) return false;
+        return true;
+}
+
+template <class Fq>
+basic_recoder<Fq>::basic_recoder(size_t n, size_t ncols, const context &ctx)
+        : basic_decoder<Fq>(n, ncols, ctx),
+          _csrc(n)
+{}
+
+template <class Fq>
+bool basic_recoder<Fq>::recode(random::mt_state *rnd_state,
+                               Element *coefs, Element *payload)
+{
+        const size_t n = this->size();
+        const size_t ncols = this->ncols();
+        const region_ops<Element> &ops = Fq::region(*this->_ctx.kernel);
+
+        if (!this->_rank) return false;
+
+        // The prepared coefficients serve both the coefficient vectors and
+        // the payloads
+        size_t count = 0;
+        for (size_t c=0; c<n; ++c)
+        {
+                if (!this->_pivot[c]) continue;
+                const Element h = Element(random::generate(rnd_state));
+                if (!h) continue;
+
+                ops.prepare(reinterpret_cast<char*>(&this->_prep[0])
+                            + count*ops.prepared_size, h);
+                _csrc[count] = RA(this->_coefs, c);
+                this->_src[count++] = RA(this->_data, c);
+        }
+
+        memset(coefs, 0, n*sizeof(Element));
+        memset(payload, 0, ncols*sizeof(Element));
+        if (count)
+        {
+                ops.addto_mul_panel(coefs, &_csrc[0], 0, &this->_prep[0],
+                                    count, n);
+                ops.addto_mul_panel(payload, &this->_src[0], 0,
+                                    &this->_prep[0], count, ncols);
+        }
+        return true;
+}
+
+template void seed_coefficients<Field<GF256> >(
+        random::random_type seed, Field<GF256>::fq_t *coefs, size_t n);
+template void seed_coefficients<Field<GF65536> >(
+        random::random_type seed, Field<GF65536>::fq_t *coefs, size_t n);
+template void seed_coefficients<Field<GF2_32> >(
+        random::random_type seed, Field<GF2_32>::fq_t *coefs, size_t n);
+template <class Fq>
+basic_window_encoder<Fq>::basic_window_encoder(size_t window, size_t ncols,
+                                               const context &ctx)
+        : _ctx(ctx),
+          _sources(window, ncols),
+          _end(0),
+          _count(0),
+          _prep((window*Fq::region(*ctx.kernel).prepared_size + 7) / 8),
+          _src(window)
+{}
+
+template <class Fq>
+void basic_window_encoder<Fq>::push(const Element *source)
+{
+        memcpy(RA(_sources, _end % window()), source,
+               ncols()*sizeof(Element));
+        ++_end;
+        if (_count < window()) ++_count;
+}
+
+template <class Fq>
+void basic_window_encoder<Fq>::encode(random::mt_state *rnd_state,
+                                      Element *coefs, Element *payload)
+{
+        const region_ops<Element> &ops = Fq::region(*_ctx.kernel);
+
+        size_t count = 0;
+        for (size_t t=0; t<_count; ++t)
+        {
+                coefs[t] = Element(random::generate(rnd_state));
+                if (!coefs[t]) continue;
+                ops.prepare(reinterpret_cast<char*>(&_prep[0])
+                            + count*ops.prepared_size, coefs[t]);
+                _src[count++] = RA(_sources, (first() + t) % window());
+        }
+
+        memset(payload, 0, ncols()*sizeof(Element));
+        if (count)
+                ops.addto_mul_panel(payload, &_src[0], 0, &_prep[0], count,
+                                    ncols());
+}
+
+template <class Fq>
+basic_window_decoder<Fq>::basic_window_decoder(size_t window, size_t ncols,
+                                               const context &ctx)
+        : ring(window, ncols, ctx),
+          _base(0),
+          _next(0),
+          _lost(0)
+{}
+
+template <class Fq>
+bool basic_window_decoder<Fq>::add(size_t first, size_t count,
+                                   const Element *coefs,
+                                   const Element *payload)
+{
+        const size_t w = window();
+        if (count > w)
+                throw std::string("Packet wider than the window");
+
+        // The sources before the ring are gone; only a packet that does
+        // not combine them is of use
+        size_t t = 0;
+        for (; t<count && first+t < _base; ++t)
+                if (coefs[t]) return false;
+
+        if (first + count > _base + w)
+                slide(first + count - w);
+
+        Element * const v = &this->_v[0];
+        memset(v, 0, w*sizeof(Element));
+        for (; t<count; ++t)
+                v[(first + t) % w] = coefs[t];
+        return this->insert(payload);
+}
+
+template <class Fq>
+void basic_window_decoder<Fq>::slide(size_t base)
+{
+        const size_t w = window();
+        if (_next < base)
+        {
+                _lost += base - _next;
+                _next = base;
+        }
+
+        // The columns leaving are reused by the sources entering, so no row
+        // may combine them any more
+        for (size_t s=std::max(_base, base < w ? 0 : base - w); s<base; ++s)
+        {
+                const size_t c = s % w;
+                for (size_t r=0; r<w; ++r)
+                        if (this->_pivot[r]
+                            && (r == c || E(this->_coefs, r, c)))
+                        {
+                                this->_pivot[r] = 0;
+                                --this->_rank;
+                        }
+        }
+        _base = base;
+}
+
+template class basic_encoder<Field<GF256> >;
+template class basic_encoder<Field<GF65536> >;
+template class basic_encoder<Field<GF2_32> >;
+template class basic_decoder<Field<GF256> >;
+template class basic_decoder<Field<GF65536> >;
+template class basic_decoder<Field<GF2_32> >;
+template class basic_recoder<Field<GF256> >;
+template class basic_recoder<Field<GF65536> >;
+template class basic_recoder<Field<GF2_32> >;
+template class basic_window_encoder<Field<GF256> >;
+template class basic_window_encoder<Field<GF65536> >;
+template class basic_window_encoder<Field<GF2_32> >;
+template class basic_window_decoder<Field<GF256> >;
+template class basic_window_decoder<Field<GF65536> >;
+template class basic_window_decoder<Field<GF2_32> >;
+
+}
+}
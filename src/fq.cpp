@@ -33,17 +33,83 @@ namespace rnc
 namespace fq
 {
 
-static fq_t ltab[fq_size];
+/** \brief Multiplication by shift-and-add, reducing with the polynomial
 
-void init()
+    Used only to generate the tables at compile time.
+ */
+template <class F>
+static constexpr typename F::fq_t slow_mul(typename F::fq_t a,
+                                           typename F::fq_t b)
+{
+        uint32_t r = 0, x = a;
+        for (; b; b >>= 1)
+        {
+                if (b & 1) r ^= x;
+                x <<= 1;
+                if (x & F::size) x ^= F::polynomial;
+        }
+        return typename F::fq_t(r);
+}
+
+/** \brief Generates the power and logarithm tables of the generator
+
+    The power table spans two periods, so that sums and differences of
+    logarithms index it directly.
+ */
+template <class F>
+static constexpr field_tables<typename F::fq_t, F::size> make_tables()
 {
-#pragma message "fq::init is OBSOLETE"
-/// \todo Obsolete this function. logtable should be calculated off-line;
-/// testing should be externalized.
+        typedef typename F::fq_t fq_t;
+
+        // Multiplication by the generator is linear: look it up nibble by
+        // nibble, which keeps the compile-time evaluation cheap.
+        const int nibbles = sizeof(fq_t)*2;
+        fq_t gmul[nibbles][16] {};
+        for (int p=0; p<nibbles; ++p)
+                for (int x=0; x<16; ++x)
+                        gmul[p][x] = slow_mul<F>(F::generator, fq_t(x << (4*p)));
+
+        field_tables<fq_t, F::size> t {};
+        fq_t x = 1;
+        for (size_t i=0; i<F::groupsize; ++i)
+        {
+                t.pow[i] = t.pow[i+F::groupsize] = x;
+                t.log[x] = fq_t(i);
+
+                fq_t y = 0;
+                for (int p=0; p<nibbles; ++p)
+                        y ^= gmul[p][(x >> (4*p)) & 0x0f];
+                x = y;
+        }
+        t.pow[2*F::groupsize] = t.pow[0];
+        t.pow[2*F::groupsize+1] = t.pow[1];
+        return t;
+}
 
-	for (int i=0; i<fq_size-1; i++)
-		ltab[pow_table[i]] = i;
+// Constant-initialized: placed in read-only pages of the shared object, shared
+// by all processes, and needs no run-time setup. Being constexpr, a table the
+// compiler cannot evaluate is a build error, not a silent dynamic
+// initialization.
+constexpr field_tables<GF256::fq_t, 256> GF256::tables = make_tables<GF256>();
+constexpr field_tables<GF65536::fq_t, 65536> GF65536::tables =
+        make_tables<GF65536>();
+
+const unsigned int GF256::size;
+const unsigned int GF256::groupsize;
+const unsigned int GF256::polynomial;
+const unsigned int GF256::generator;
+const unsigned int GF65536::size;
+const unsigned int GF65536::groupsize;
+const unsigned int GF65536::polynomial;
+const unsigned int GF65536::generator;
+const uint64_t GF2_32::size;
+const uint32_t GF2_32::groupsize;
+const uint64_t GF2_32::polynomial;
+const unsigned int GF2_32::generator;
+const uint64_t GF2_32::barrett;
 
+void init()
+{
 #ifdef VERIFY_FQ
 	for (int i=0; i<fq_size;i++)
 		for (int j=0;j<fq_size;j++)
@@ -79,16 +145,6 @@ void init()
 #endif
 }
 
-const fq_t pow_table[fq_size] =
-#if Q256 != 0
-#include "pow_table_8"
-#else
-#include "pow_table_16"
-#endif //Q256
-;
-
-const fq_t * const log_table = ltab;
-
 #include <stdlib.h>
 
 static unsigned int rand_seed;
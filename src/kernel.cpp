@@ -0,0 +1,145 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Run-time CPU feature detection and region kernel dispatch
+ */
+
+#include <rnc-lib/field.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RNC_X86 1
+#include <cpuid.h>
+#endif
+
+namespace rnc
+{
+namespace fq
+{
+
+extern const kernel_set kernel_sets[KERNEL_AUTO];
+
+const kernel_set *active_kernel = &kernel_sets[KERNEL_GENERIC];
+
+#ifdef RNC_X86
+
+/// \brief Extended control register 0: register state enabled by the OS
+static uint64_t xgetbv0()
+{
+        uint32_t eax, edx;
+        __asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (uint64_t(edx) << 32) | eax;
+}
+
+/// \brief Bit mask of the tiers supported by the CPU and the OS
+static unsigned int detect()
+{
+        unsigned int tiers = 1 << KERNEL_GENERIC;
+        unsigned int eax, ebx, ecx, edx;
+
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+                return tiers;
+
+        if (edx & (1<<26)) tiers |= 1 << KERNEL_SSE2;
+        if (ecx & (1<<9)) tiers |= 1 << KERNEL_SSSE3;
+
+        // AVX and wider: the OS must save the YMM (and ZMM) registers
+        const bool osxsave = ecx & (1<<27);
+        const bool avx = ecx & (1<<28);
+        if (!(osxsave && avx)) return tiers;
+        const uint64_t xcr0 = xgetbv0();
+        if ((xcr0 & 0x06) != 0x06) return tiers;
+
+        if (__get_cpuid_max(0, 0) < 7) return tiers;
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+        const bool avx2 = ebx & (1<<5);
+        if (avx2) tiers |= 1 << KERNEL_AVX2;
+        if ((ebx & (1<<16)) && (ebx & (1<<30)) && (xcr0 & 0xe6) == 0xe6)
+                tiers |= 1 << KERNEL_AVX512BW;
+        if (avx2 && (ecx & (1<<8)))
+                tiers |= 1 << KERNEL_GFNI;
+
+        return tiers;
+}
+
+/** \brief Whether the CPU supports PCLMULQDQ
+
+    Not a tier of its own: the GF(2^32) kernels of the x86 tiers check it,
+    and fall back to the portable kernel.
+ */
+bool cpu_has_clmul()
+{
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1<<1));
+}
+
+#else
+
+static unsigned int detect()
+{
+        return 1 << KERNEL_GENERIC;
+}
+
+#endif //RNC_X86
+
+bool cpu_supports(kernel_tier tier)
+{
+        static const unsigned int tiers = detect();
+        return tier >= KERNEL_GENERIC && tier < KERNEL_AUTO
+                && (tiers & (1 << tier));
+}
+
+const kernel_set *select_kernel(kernel_tier tier)
+{
+        if (tier == KERNEL_AUTO)
+        {
+                int t = KERNEL_AUTO - 1;
+                while (!cpu_supports(kernel_tier(t))) --t;
+                tier = kernel_tier(t);
+        }
+        else if (!cpu_supports(tier))
+                return 0;
+
+        return active_kernel = &kernel_sets[tier];
+}
+
+/** \brief Binds #active_kernel when the library is loaded
+
+    Honors the RNC_KERNEL environment variable; an unknown or unsupported
+    value falls back to automatic selection.
+ */
+static struct kernel_init
+{
+        kernel_init()
+        {
+                const char *name = getenv("RNC_KERNEL");
+                if (name)
+                        for (int t=KERNEL_GENERIC; t<KERNEL_AUTO; ++t)
+                                if (!strcmp(name, kernel_sets[t].name)
+                                    && select_kernel(kernel_tier(t)))
+                                        return;
+
+                select_kernel(KERNEL_AUTO);
+        }
+} init_kernel;
+
+}
+}
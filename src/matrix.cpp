@@ -21,14 +21,14 @@
  */
 
 #include <rnc-lib/matrix.h>
+#include <rnc-lib/pool.h>
 #include <time.h>
 #include <string.h>
-#include <glib.h>
-#include <mkstr>
 #include <auto_arr_ptr>
+#include <algorithm>
 #include <string>
+#include <cassert>
 
-using namespace rnc::fq;
 
 namespace rnc
 {
@@ -36,335 +36,1762 @@ namespace matrix
 {
 
 int BLOCK_SIZE = 1;
-int NCPUS = 2;
+int NCPUS = pool::cpu_count();
 
-static void checkGError(char const * const context, GError *error)
-{
-        if (error != 0)
-        {
-                std::string ex = MKStr() << "glib error: "
-                                    << context << ": " << error->message;
-                g_error_free(error);
-                throw ex;
-        }
-}
+/// \brief Local names of the matrix types over \c Fq in templated functions
+#define MATRIX_TYPES(Fq)                                        \
+        typedef basic_matrix<Fq> Matrix;                        \
+        typedef typename Matrix::Element Element;               \
+        typedef typename Matrix::Row Row
 
-void set_identity(Matrix &m) throw()
+template <class Fq>
+void set_identity(basic_matrix<Fq> &m) throw()
 {
+        MATRIX_TYPES(Fq);
         CACHE_DIMS(m);
 
-        Row *row = m.rows;
-        for (size_t i=0; i<nrows; ++i, ++row)
+        Row row = m.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride)
         {
-                Element *elem = *row;
+                Element *elem = row;
                 for (size_t j=0; j<ncols; ++j, ++elem)
                         *elem = i==j ? 1 : 0;
         }
 }
 
-void set_zero(Matrix &m) throw()
+template <class Fq>
+void set_zero(basic_matrix<Fq> &m) throw()
 {
+        MATRIX_TYPES(Fq);
         CACHE_DIMS(m);
         const size_t rowsize = ncols * sizeof(Element);
 
-        Row *row = m.rows;
-        for (size_t i=0; i<nrows; ++i, ++row)
+        Row row = m.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride)
         {
-                memset(*row, 0, rowsize);
+                memset(row, 0, rowsize);
         }
 }
 
-void copy(const Matrix &m, Matrix &md) throw()
+template <class Fq>
+void copy(const basic_matrix<Fq> &m, basic_matrix<Fq> &md) throw()
 {
+        MATRIX_TYPES(Fq);
         CACHE_DIMS(m);
         const size_t rowsize = ncols*sizeof(Element);
 
-        Row *row = m.rows, *rowD = md.rows;
-        for (size_t i=0; i<nrows; ++i, ++row, ++rowD)
-                memcpy(*rowD, *row, rowsize);
+        Row row = m.data, rowD = md.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride, rowD += md.stride)
+                memcpy(rowD, row, rowsize);
 }
 
-void copy(const Matrix &m, Element* dest) throw()
+template <class Fq>
+void copy(const basic_matrix<Fq> &m,
+          typename basic_matrix<Fq>::Element* dest) throw()
 {
+        MATRIX_TYPES(Fq);
         CACHE_DIMS(m);
         const size_t rowsize = ncols*sizeof(Element);
 
-        Row *row = m.rows;
+        Row row = m.data;
         Element *d = dest;
-        for (size_t i=0; i<nrows; ++i, ++row, d+=ncols)
-                memcpy(d, *row, rowsize);
+        for (size_t i=0; i<nrows; ++i, row += m.stride, d+=ncols)
+                memcpy(d, row, rowsize);
 }
 
-bool invert(const Matrix &m_in, Matrix &res) throw ()
+template <class Fq>
+bool invert(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res)
 {
-        CACHE_DIMS(m_in);
+        return invert(m_in, res, context());
+}
 
-        Matrix m(nrows, ncols);
-        copy(m_in, m);
-        set_identity(res);
+template <class Fq>
+bool invert(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res,
+            const context &ctx)
+{
+        return invert_rank(m_in, res, 0, ctx) == m_in.nrows;
+}
+
+template <class Fq>
+size_t invert_rank(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res,
+                   std::vector<size_t> *dependent)
+{
+        return invert_rank(m_in, res, dependent, context());
+}
+
+/** \brief LU factorization with row pivoting, in place
+
+    Gauss elimination, a column at a time, which keeps the factors for
+    #lu_solve instead of clearing them. At step \c t, row \c ipiv[t] is
+    swapped with row \c t, and its pivot is in column \c pivcol[t]. The
+    swaps exchange whole rows, so that the factors follow their rows. For
+    the rows \f$t < rank\f$:
+    - \f$E(m, t, pivcol[t])\f$ is the inverse of the pivot;
+    - \f$E(m, t, pivcol[s])\f$ for \f$s < t\f$ is the multiple of the
+      normalized pivot row \c s added to row \c t at step \c s;
+    - the other columns after \c pivcol[t] are the normalized row.
 
-        Row *rm = m.rows;
-        Row *rd = res.rows;
-        for (size_t i=0; i<nrows; ++i, ++rm, ++rd)
+    The columns without a pivot are skipped, so that the rank of singular
+    matrices is found too.
+
+    \return The rank of \c m
+ */
+template <class Fq>
+static size_t factorize(basic_matrix<Fq> &m, size_t *ipiv, size_t *pivcol,
+                        const kernel_set &k)
+{
+        MATRIX_TYPES(Fq);
+        CACHE_DIMS(m);
+
+        size_t rank = 0;
+        for (size_t c=0; c<ncols && rank<nrows; ++c)
         {
-                Row const m_i = *rm;
-                Row const res_i = *rd;
+                size_t p = rank;
+                while (p < nrows && E(m, p, c) == 0) ++p;
+                if (p == nrows) continue;
+
+                ipiv[rank] = p;
+                pivcol[rank] = c;
+                if (p != rank)
+                        std::swap_ranges(RA(m,p), RA(m,p)+ncols, RA(m,rank));
+
+                Row const m_i = RA(m,rank);
 
-                //normalize row
-                const Element p = RE(m_i,i);
-                if (p == 0) return false; // \todo: row-switch
+                //normalize row, keeping the inverse of the pivot
+                const Element pinv = Fq::inv(RE(m_i,c));
+                Fq::mul_region(k, m_i+c+1, m_i+c+1, pinv, ncols-c-1);
+                RE(m_i,c) = pinv;
 
-                for (size_t c=0; c<ncols; ++c)
+                //the multiples stay in column c
+                for (size_t r=rank+1; r<nrows; ++r)
                 {
-                        if (c>=i) divby(RE(m_i,c), p);
-                        divby(RE(res_i,c), p);
+                        Row const m_r = RA(m,r);
+                        Fq::addto_mul_region(k, m_r+c+1, m_i+c+1, RE(m_r,c),
+                                             ncols-c-1);
                 }
+                ++rank;
+        }
+        return rank;
+}
 
-                Row *frm = rm+1;
-                Row *frd = rd+1;
-                for (size_t r=i+1; r<ncols; ++r, ++frm, ++frd)
-                {
-                        Row const m_r = *frm;
-                        Row const res_r = *frd;
-                        const Element h = RE(m_r,i);
+/// \brief Applies the row swaps \c ipiv of #factorize to \c perm
+static void permute(std::vector<size_t> &perm, size_t r0,
+                    const size_t *ipiv, size_t rank)
+{
+        for (size_t t=0; t<rank; ++t)
+                std::swap(perm[r0+t], perm[r0+ipiv[t]]);
+}
+
+/** \brief Prepares element (r, c) of \c m at \c p for
+    region_ops::addto_mul_panel
+
+    \return false, if the element is zero: nothing is prepared.
+ */
+template <class Fq>
+static inline bool prepare_coef(const region_ops<typename Fq::fq_t> &ops,
+                                void *p, const basic_matrix<Fq> &m,
+                                size_t r, size_t c)
+{
+        const typename Fq::fq_t e = E(m, r, c);
+        if (!e) return false;
+        ops.prepare(p, e);
+        return true;
+}
+
+/// \brief #prepare_coef from the log domain, without converting the element
+template <class Fq>
+static inline bool prepare_coef(const region_ops<typename Fq::fq_t> &ops,
+                                void *p, const basic_log_matrix<Fq> &m,
+                                size_t r, size_t c)
+{
+        const typename Fq::fq_t l = E(m, r, c);
+        if (l == Fq::log_zero) return false;
+        ops.prepare_log(p, l);
+        return true;
+}
+
+/// \brief Columns of \c m packed per pass of #mul_panels
+template <class M1>
+static inline size_t panel_columns(const M1 &m, const context &ctx)
+{
+        return std::min(std::max<size_t>(ctx.panel_depth, 1), m.ncols);
+}
+
+/// \brief All the columns of a sparse \c m are packed at once
+template <class Fq>
+static inline size_t panel_columns(const basic_sparse_matrix<Fq> &m,
+                                   const context &)
+{
+        return m.ncols;
+}
+
+/// \brief Coefficients of a row of \c m packed per pass of #mul_panels
+template <class M1>
+static inline size_t panel_slots(const M1 &m, const context &ctx)
+{
+        return panel_columns(m, ctx);
+}
+
+/// \brief The most non-zero elements of a row of a sparse \c m
+template <class Fq>
+static inline size_t panel_slots(const basic_sparse_matrix<Fq> &m,
+                                 const context &)
+{
+        size_t slots = 1;
+        for (size_t i=0; i<m.nrows; ++i)
+                slots = std::max(slots, m.nnz(i));
+        return slots;
+}
+
+/** \brief Packed panel of a left-hand side matrix
+
+    The non-zero coefficients of columns [k, lk) of some rows of \c m1, at
+    most \c depth per row (see #panel_slots), prepared for
+    region_ops::addto_mul_panel, each with the row of \c m2 it multiplies.
+    Zero coefficients are dropped, which makes sparse coefficient rows
+    proportionally cheaper.
+ */
+template <class Fq>
+struct packed_panel
+{
+        typedef typename Fq::fq_t Element;
+
+        const region_ops<Element> &ops;
+        const size_t depth;
+        /// \brief Prepared coefficients, \c depth slots per row
+        auto_arr_ptr<uint64_t> prep;
+        /// \brief Rows of \c m2, \c depth slots per row
+        auto_arr_ptr<const Element*> src;
+        /// \brief Coefficients packed per row
+        auto_arr_ptr<size_t> count;
 
-                        for (size_t c=0; c<ncols; ++c)
+        packed_panel(const region_ops<Element> &o, size_t rows, size_t d)
+                : ops(o), depth(d),
+                  prep(new uint64_t[(rows*d*o.prepared_size + 7) / 8]),
+                  src(new const Element*[rows*d]),
+                  count(new size_t[rows])
+        {}
+
+        void *slot(size_t r, size_t t) const {
+                return reinterpret_cast<char*>(prep.ptr())
+                        + (r*depth + t)*ops.prepared_size; }
+
+        /// \brief Packs columns [k, lk) of rows [i0, i0+rows) of \c m1
+        template <class M1>
+        void pack(const M1 &m1, const basic_matrix<Fq> &m2,
+                  size_t i0, size_t rows, size_t k, size_t lk)
+        {
+                for (size_t r=0; r<rows; ++r)
+                {
+                        size_t c = 0;
+                        for (size_t kk=k; kk<lk; ++kk)
                         {
-                                if (c>=i) addto_mul(RE(m_r,c), RE(m_i,c), h);
-                                addto_mul(RE(res_r, c), RE(res_i,c), h);
+                                if (!prepare_coef(ops, slot(r, c), m1,
+                                                  i0+r, kk))
+                                        continue;
+                                src[r*depth + c] = RA(m2, kk);
+                                ++c;
                         }
+                        count[r] = c;
                 }
         }
 
-        //back-substitution
-        rd = res.rows + nrows - 1;
-        rm = m.rows + nrows - 1;
-        for (int i=nrows-1; i>=0; --i, --rd, --rm)
-        {
-                Row const res_i = *rd;
+        /** \brief #pack for a sparse \c m1, visiting its non-zero elements
 
-                Row *rbd = rd - 1;
-                Row *rbm = rm - 1;
-                for (int r = i - 1; r>=0; --r, --rbd, --rbm)
+            The first column of the range is found by binary search, the
+            columns of the rows being ascending.
+         */
+        void pack(const basic_sparse_matrix<Fq> &m1,
+                  const basic_matrix<Fq> &m2,
+                  size_t i0, size_t rows, size_t k, size_t lk)
+        {
+                const size_t *col = m1.col.data();
+                for (size_t r=0; r<rows; ++r)
                 {
-                        Row const res_r = *rbd;
-                        Row const m_r = *rbm;
-                        const Element h = RE(m_r,i);
-                        RE(m_r,i) = 0;
-
-                        for (size_t c=0; c<ncols; ++c)
-                                addto_mul(RE(res_r,c), RE(res_i,c), h);
+                        const size_t *e = std::lower_bound(
+                                col + m1.row_start[i0+r],
+                                col + m1.row_start[i0+r+1], k);
+                        const size_t *le = col + m1.row_start[i0+r+1];
+                        size_t c = 0;
+                        for (; e != le && *e < lk; ++e, ++c)
+                        {
+                                ops.prepare(slot(r, c), m1.val[e - col]);
+                                src[r*depth + c] = RA(m2, *e);
+                        }
+                        count[r] = c;
                 }
         }
+};
 
-        return true;
+/** \brief Bytes of prepared coefficients #mul_panels packs at a time
+
+    Rows are packed and multiplied in chunks of this size, so that the
+    prepared coefficients are still in the cache when they are used: a
+    panel of a tall left-hand side matrix would not fit.
+ */
+static const size_t PACKED_BYTES = 256*1024;
+
+/** \brief Rows [i0, li), columns [j0, lj) of \f$md:=m1*m2\f$
+
+    See #mul for the order of the computation. If \c add, the product is
+    added to \c md instead: \f$md:=md+m1*m2\f$.
+ */
+template <class M1>
+void mul_panels(const M1 &m1, const basic_matrix<typename M1::field> &m2,
+                basic_matrix<typename M1::field> &md,
+                size_t i0, size_t li, size_t j0, size_t lj,
+                const context &ctx, bool add = false)
+{
+        typedef typename M1::field Fq;
+        typedef typename Fq::fq_t Element;
+        const size_t rows = li - i0;
+        const size_t cols1 = m1.ncols;
+        if (!rows || lj <= j0) return;
+
+        if (!add)
+                for (size_t i=i0; i<li; ++i)
+                        memset(A(md, i, j0), 0, (lj-j0)*sizeof(Element));
+        if (!cols1) return;
+
+        const size_t cols = panel_columns(m1, ctx);
+        const size_t depth = panel_slots(m1, ctx);
+        const size_t width = std::max<size_t>(
+                ctx.panel_bytes / sizeof(Element), 1);
+        const region_ops<Element> &ops = Fq::region(*ctx.kernel);
+        const size_t chunk = std::min(std::max<size_t>(
+                        PACKED_BYTES / (depth*ops.prepared_size), 1), rows);
+        packed_panel<Fq> panel(ops, chunk, depth);
+
+        for (size_t k=0; k<cols1; k+=cols)
+                for (size_t c0=i0; c0<li; c0+=chunk)
+                {
+                        const size_t cr = std::min(chunk, li-c0);
+                        panel.pack(m1, m2, c0, cr, k,
+                                   std::min(k + cols, cols1));
+                        for (size_t j=j0; j<lj; j+=width)
+                        {
+                                const size_t n = std::min(width, lj-j);
+                                for (size_t r=0; r<cr; ++r)
+                                        if (panel.count[r])
+                                                ops.addto_mul_panel(
+                                                        A(md, c0+r, j),
+                                                        panel.src + r*depth,
+                                                        j, panel.slot(r, 0),
+                                                        panel.count[r], n);
+                        }
+                }
 }
 
+/// \brief Tiles per thread #pmul aims at, so that stealing can even out
+static const size_t TILES_PER_THREAD = 4;
+
 /** \brief Description of a single workunit
 
-    Matrix multiplication threads process workunits described with this
-    construct.
+    Matrix multiplication threads process tiles of the result described with
+    this construct. The result is split into \c rtiles x \c ctiles tiles of
+    \c trows rows and \c tcols columns (less at the bottom and right edges).
+    Tiles are numbered row-major, so that consecutive ones share the rows of
+    \c m1.
  */
-typedef struct muldata
+template <class M1>
+struct muldata
 {
         /// \brief Left-hand side matrix
-        const Matrix &m1;
+        const M1 &m1;
         /// \brief Right-hand side matrix
-        const Matrix &m2;
+        const basic_matrix<typename M1::field> &m2;
         /// \brief Result address
-        Matrix &md;
-} muldata;
-
-void mulrow_blk(gpointer bb, gpointer d)
-{
-        muldata *data = reinterpret_cast<muldata*>(d);
-
-        const int b = BLOCK_SIZE;
-        const size_t cols1 = data->m1.ncols;
-        const size_t cols2 = data->m2.ncols;
-        const size_t rows1 = data->m1.nrows;
-        Matrix &md = data->md;
-        const Matrix &m1 = data->m1;
-        const Matrix &m2 = data->m2;
-
-        size_t k, j;
-        const size_t i = (size_t)bb - 1;
-        const size_t li=i+b > rows1 ? rows1 : i+b;
-        size_t lk, lj;
-        size_t i0,j0,k0;
-
-        for (j=0, lj=b; j < cols2; j+=b, lj+=b) {
-                if (lj > cols2) lj=cols2;
-
-                for (k=0, lk=b; k < cols1; k+=b, lk+=b) {
-                        if (lk > cols1) lk=cols1;
-
-                        for (i0=i; i0<li; ++i0) {
-                                for (k0=k; k0<lk; ++k0) {
-                                        const Element e1 = E(m1, i0, k0);
-                                        for (j0=j; j0<lj; ++j0) {
-                                                addto_mul(E(md, i0, j0),
-                                                          e1,
-                                                          E(m2, k0, j0));
-                                        }
-                                }
-                        }
+        basic_matrix<typename M1::field> &md;
+        /// \brief Rows and columns of a tile
+        size_t trows, tcols;
+        /// \brief Tiles along the rows and the columns
+        size_t rtiles, ctiles;
+        /// \brief Settings of the operation
+        const context &ctx;
+        /// \brief Whether the product is added to \c md
+        bool add;
+};
+
+/// \brief Task of #pmul: the \c t th tile of the result
+template <class M1>
+void multile(size_t t, void *d)
+{
+        muldata<M1> *data = reinterpret_cast<muldata<M1>*>(d);
+        const size_t i0 = (t / data->ctiles) * data->trows;
+        const size_t j0 = (t % data->ctiles) * data->tcols;
+        mul_panels(data->m1, data->m2, data->md,
+                   i0, std::min(i0 + data->trows, data->m1.nrows),
+                   j0, std::min(j0 + data->tcols, data->m2.ncols),
+                   data->ctx, data->add);
+}
+
+/** \brief #pmul by a left-hand side matrix of type \c M1, over 2D tiles
+
+    The tiles span all the rows, and are as wide as context::tile_panel_bytes
+    allows, but narrower (down to context::tile_min_row_bytes) if that is
+    needed for #TILES_PER_THREAD tiles per thread: the result of encoding is
+    typically a few rows by millions of columns. If that is still not
+    enough, the rows are split as well. The width of the tiles is a multiple
+    of the alignment of the rows.
+ */
+template <class M1>
+void pmul_tiled(const M1 &m1, const basic_matrix<typename M1::field> &m2,
+                basic_matrix<typename M1::field> &md, const context &ctx,
+                bool add = false)
+{
+        typedef basic_matrix<typename M1::field> Matrix;
+        typedef typename M1::Element Element;
+        const size_t rows1 = m1.nrows;
+        const size_t cols1 = m1.ncols;
+        const size_t cols2 = m2.ncols;
+        if (!rows1 || !cols2) return;
+
+        const size_t unit = Matrix::ALIGNMENT / sizeof(Element);
+        const size_t want = TILES_PER_THREAD * ctx.ncpus;
+
+        const size_t mincols = ctx.tile_min_row_bytes / sizeof(Element);
+        size_t tcols = std::max(ctx.tile_panel_bytes
+                                / (std::max<size_t>(cols1, 1)
+                                   * sizeof(Element)),
+                                mincols);
+        if ((cols2 + tcols - 1) / tcols < want)
+                tcols = std::max((cols2 + want - 1) / want, mincols);
+        tcols = std::min(std::max(tcols / unit, size_t(1)) * unit, cols2);
+        const size_t ctiles = (cols2 + tcols - 1) / tcols;
+
+        const size_t rtiles = std::min(rows1, (want + ctiles - 1) / ctiles);
+        const size_t trows = (rows1 + rtiles - 1) / rtiles;
+
+        muldata<M1> d = { m1, m2, md, trows, tcols,
+                           (rows1 + trows - 1) / trows, ctiles, ctx, add };
+        pool::run(multile<M1>, &d, d.rtiles * d.ctiles, ctx.ncpus);
+}
+
+/// \brief #mul by a left-hand side matrix of type \c M1; see #mul_panels
+template <class M1>
+void mul_any(const M1 &m1, const basic_matrix<typename M1::field> &m2,
+             basic_matrix<typename M1::field> &md, const context &ctx,
+             bool add = false)
+{
+        mul_panels(m1, m2, md, 0, m1.nrows, 0, m2.ncols, ctx, add);
+}
+
+/// \brief #pmul by a left-hand side matrix of type \c M1
+template <class M1>
+void pmul_any(const M1 &m1, const basic_matrix<typename M1::field> &m2,
+              basic_matrix<typename M1::field> &md, const context &ctx,
+              bool add = false)
+{
+        if (ctx.ncpus == 1)
+                mul_any(m1, m2, md, ctx, add);
+        else
+                pmul_tiled(m1, m2, md, ctx, add);
+}
+
+template <class Fq>
+void mul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+         basic_matrix<Fq> &md)
+{
+        mul_any(m1, m2, md, context());
+}
+
+template <class Fq>
+void mul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+         basic_matrix<Fq> &md, const context &ctx)
+{
+        mul_any(m1, m2, md, ctx);
+}
+
+template <class Fq>
+void pmul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+          basic_matrix<Fq> &md)
+{
+        pmul_any(m1, m2, md, context());
+}
+
+template <class Fq>
+void pmul(const basic_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+          basic_matrix<Fq> &md, const context &ctx)
+{
+        pmul_any(m1, m2, md, ctx);
+}
+
+/** \brief Work areas of #reduce and #lu_solve, for matrices of up to
+    \c nrows rows and \c n columns
+
+    Allocated by the caller, so that one reducing many matrices allocates
+    them once.
+ */
+template <class Fq>
+struct reduce_space
+{
+        typedef typename Fq::fq_t Element;
+
+        /// \brief Row swaps and pivot columns of #factorize
+        std::vector<size_t> ipiv, pivcol;
+        /// \brief Inverses of the pivots
+        std::vector<Element> pinv;
+        /// \brief Multiples of the rows before and after each row
+        packed_panel<Fq> lower, upper;
+
+        reduce_space(const region_ops<Element> &ops, size_t nrows, size_t n)
+                : ipiv(nrows), pivcol(nrows), pinv(n),
+                  lower(ops, n, n), upper(ops, n, n)
+        {}
+};
+
+/// \brief Factors of #lu_solve, and a tile of columns of the right-hand side
+template <class Fq>
+struct solvedata
+{
+        /// \brief Right-hand side, and result
+        basic_matrix<Fq> &rhs;
+        /// \brief Order of the factorized matrix
+        size_t n;
+        /// \brief Row swaps to replay, or 0
+        const size_t *ipiv;
+        /// \brief Inverses of the pivots
+        const typename Fq::fq_t *pinv;
+        /// \brief Multiples of the rows before and after each row
+        const packed_panel<Fq> &lower, &upper;
+        /// \brief Columns of a tile
+        size_t tcols;
+};
+
+/// \brief Task of #lu_solve: the \c t th tile of columns
+template <class Fq>
+void solve_tile(size_t t, void *d)
+{
+        typedef typename Fq::fq_t Element;
+        solvedata<Fq> *data = reinterpret_cast<solvedata<Fq>*>(d);
+        basic_matrix<Fq> &rhs = data->rhs;
+        const packed_panel<Fq> &lower = data->lower, &upper = data->upper;
+        const region_ops<Element> &ops = lower.ops;
+        const size_t n = data->n;
+        const size_t j0 = t * data->tcols;
+        const size_t cols = std::min(data->tcols, rhs.ncols - j0);
+
+        if (data->ipiv)
+                for (size_t s=0; s<n; ++s)
+                        if (data->ipiv[s] != s)
+                                std::swap_ranges(A(rhs, s, j0),
+                                                 A(rhs, s, j0) + cols,
+                                                 A(rhs, data->ipiv[s], j0));
+
+        // forward substitution: each row gets the multiples of the rows
+        // before, and is normalized
+        for (size_t s=0; s<n; ++s)
+        {
+                Element * const row = A(rhs, s, j0);
+                if (lower.count[s])
+                        ops.addto_mul_panel(row, lower.src + s*lower.depth, j0,
+                                            lower.slot(s, 0), lower.count[s],
+                                            cols);
+                ops.mul(row, row, data->pinv[s], cols);
+        }
+        // back-substitution
+        for (size_t s=n; s-- > 0; )
+                if (upper.count[s])
+                        ops.addto_mul_panel(A(rhs, s, j0),
+                                            upper.src + s*upper.depth, j0,
+                                            upper.slot(s, 0), upper.count[s],
+                                            cols);
+}
+
+/** \brief Solves \f$m*x=rhs\f$ in place, \c m being factorized by
+    #factorize, with rank \c n
+
+    Rows [0, n) of \c rhs are overwritten with \c x. The row operations of
+    the factorization are replayed on \c rhs a tile of columns at a time,
+    each row combining all the multiples it gets by
+    region_ops::addto_mul_panel. A tile stays in the cache while all the
+    operations are applied to it, so the data are streamed once: neither
+    the inverse of \c m nor a temporary as large as \c rhs is needed. The
+    tiles are distributed among the threads of the pool.
+
+    \param ipiv The row swaps of #factorize, or 0 if they have been applied
+    to \c rhs already
+    \param space Its packed panels and pivot inverses are used, for up to
+    \c n columns
+ */
+template <class Fq>
+static void lu_solve(const basic_matrix<Fq> &m, size_t n, const size_t *ipiv,
+                     const size_t *pivcol, basic_matrix<Fq> &rhs,
+                     const context &ctx, reduce_space<Fq> &space)
+{
+        typedef typename Fq::fq_t Element;
+        if (!n || !rhs.ncols) return;
+
+        const region_ops<Element> &ops = Fq::region(*ctx.kernel);
+        packed_panel<Fq> &lower = space.lower, &upper = space.upper;
+        Element * const pinv = &space.pinv[0];
+        for (size_t t=0; t<n; ++t)
+        {
+                size_t lc = 0, uc = 0;
+                for (size_t s=0; s<n; ++s)
+                {
+                        if (s == t) continue;
+                        packed_panel<Fq> &p = s < t ? lower : upper;
+                        size_t &c = s < t ? lc : uc;
+                        if (!prepare_coef(ops, p.slot(t, c), m, t, pivcol[s]))
+                                continue;
+                        p.src[t*p.depth + c] = RA(rhs, s);
+                        ++c;
                 }
+                lower.count[t] = lc;
+                upper.count[t] = uc;
+                pinv[t] = E(m, t, pivcol[t]);
         }
+
+        const size_t unit = basic_matrix<Fq>::ALIGNMENT / sizeof(Element);
+        const size_t tcols = std::min(
+                std::max(ctx.panel_bytes / sizeof(Element) / unit, size_t(1))
+                * unit, rhs.ncols);
+        solvedata<Fq> d = { rhs, n, ipiv, pinv, lower, upper, tcols };
+        pool::run(solve_tile<Fq>, &d, (rhs.ncols + tcols - 1) / tcols,
+                  ctx.ncpus);
 }
 
-void mulrow_nonblk(gpointer row, gpointer d)
+/** \brief Gauss-Jordan elimination of \c m, with the same row operations
+    performed on \c rhs
+
+    Solves \f$m*x=rhs\f$ in place for an \c m of at least as many rows as
+    columns: if its rank is full, the first rows of \c rhs are overwritten
+    with \c x; otherwise \c rhs is not changed. \c m is factorized by
+    #factorize, and the row operations are then replayed on \c rhs by
+    #lu_solve. \c m is left in an unspecified state.
+
+    \param space Work areas for at least the size of \c m
+    \return The rank of \c m; see #invert_rank for \c dependent.
+ */
+template <class Fq>
+static size_t reduce(basic_matrix<Fq> &m, basic_matrix<Fq> &rhs,
+                     std::vector<size_t> *dependent, const context &ctx,
+                     reduce_space<Fq> &space)
 {
-        const size_t i = (size_t)row-1;
-        muldata *data = reinterpret_cast<muldata*>(d);
-        const size_t cols2=data->m2.ncols;
-        const size_t cols1=data->m1.ncols;
-        Matrix &md = data->md;
-        const Matrix &m1 = data->m1;
-        const Matrix &m2 = data->m2;
+        CACHE_DIMS(m);
 
-        size_t j, k;
+        size_t * const ipiv = &space.ipiv[0];
+        size_t * const pivcol = &space.pivcol[0];
+        const size_t rank = factorize(m, ipiv, pivcol, *ctx.kernel);
 
-        for (j=0; j<cols2; ++j)
+        // Row i of m stems from row perm[i] of the original. The rows left
+        // are zero: their originals are combinations of the pivot rows.
+        if (dependent)
         {
-                Element s = 0;
-                for (k=0; k<cols1; ++k) {
-                        s = add(s, fq::mul(E(m1,i,k),
-                                           E(m2,k,j)));
-                }
-                E(md,i,j) = s;
+                std::vector<size_t> perm(nrows);
+                for (size_t i=0; i<nrows; ++i)
+                        perm[i] = i;
+                permute(perm, 0, ipiv, rank);
+                dependent->assign(perm.begin()+rank, perm.end());
         }
+        if (rank == ncols)
+                lu_solve(m, ncols, ipiv, pivcol, rhs, ctx, space);
+        return rank;
 }
 
-void pmul_blk(const Matrix &m1, const Matrix &m2, Matrix &md)
+/// \brief #reduce with work areas of its own
+template <class Fq>
+static size_t reduce(basic_matrix<Fq> &m, basic_matrix<Fq> &rhs,
+                     std::vector<size_t> *dependent, const context &ctx)
 {
-        const size_t rows1 = m1.nrows;
-        struct muldata d = { m1, m2, md };
-        GError *error = 0;
+        reduce_space<Fq> space(Fq::region(*ctx.kernel), m.nrows, m.ncols);
+        return reduce(m, rhs, dependent, ctx, space);
+}
 
-        GThreadPool *pool = g_thread_pool_new(mulrow_blk, &d,
-                                              NCPUS, true, &error);
-        checkGError("g_thread_pool_create", error);
+/** \brief #reduce, context::invert_block columns at a time
 
-        set_zero(md);
+    The first \c ncols columns of \c w are eliminated, with the same row
+    operations on its other columns and on \c rhs, if it is not 0. Each
+    block of columns is eliminated in three steps. The pivots are searched
+    for on a copy of the block, below the pivot rows found so far, and the
+    row swaps are then replayed on the full rows. The new pivot rows are
+    normalized in place by #lu_solve, from the factorization of their pivot
+    columns \f$D\f$ left in the copy. Finally the pivot columns are cleared
+    from all the other rows, by adding \f$X*R\f$ to them, where \f$X\f$
+    are their pivot columns and \f$R\f$ the normalized pivot rows: this is
+    where the time goes, and it is done by #pmul on the worker pool.
+ */
+template <class Fq>
+static size_t reduce_blocked(basic_matrix<Fq> &w, size_t ncols,
+                             basic_matrix<Fq> *rhs,
+                             std::vector<size_t> *dependent,
+                             const context &ctx)
+{
+        typedef basic_matrix<Fq> Matrix;
+        const kernel_set &k = *ctx.kernel;
+        const size_t nrows = w.nrows;
+        const size_t block = ctx.invert_block;
+
+        // the work areas of the blocks
+        reduce_space<Fq> space(Fq::region(k), block, block);
+        size_t * const ipiv = &space.ipiv[0];
+        size_t * const pivcol = &space.pivcol[0];
+        std::vector<size_t> perm(nrows);
+        for (size_t i=0; i<nrows; ++i)
+                perm[i] = i;
+
+        size_t rank = 0;
+        for (size_t c0=0; c0<ncols && rank<nrows; c0+=block)
+        {
+                const size_t cb = std::min(block, ncols-c0);
+                // The row operations apply to w from c0 on (the columns
+                // before are zero in the rows from rank on), and to rhs
+                Matrix * const parts[2] = { &w, rhs };
+                const size_t from[2] = { c0, 0 };
+
+                // pivots of the block
+                Matrix panel(nrows-rank, cb);
+                copy(Matrix(A(w, rank, c0), nrows-rank, cb, w.stride), panel);
+                const size_t r = factorize(panel, ipiv, pivcol, k);
+                if (!r) continue;
+
+                for (size_t t=0; t<r; ++t)
+                {
+                        const size_t p = rank + ipiv[t];
+                        if (p == rank + t) continue;
+                        for (int q=0; q<2; ++q)
+                                if (parts[q])
+                                        std::swap_ranges(
+                                                A(*parts[q], p, from[q]),
+                                                RA(*parts[q], p)
+                                                + parts[q]->ncols,
+                                                A(*parts[q], rank+t, from[q]));
+                }
+                permute(perm, rank, ipiv, r);
+
+                // normalize the pivot rows: solve D*X=R in place, R being
+                // the pivot rows and D their pivot columns, which the panel
+                // holds factorized
+                for (int q=0; q<2; ++q)
+                {
+                        if (!parts[q]) continue;
+                        Matrix &m = *parts[q];
+                        Matrix pivots(A(m, rank, from[q]), r,
+                                      m.ncols-from[q], m.stride);
+                        lu_solve(panel, r, (size_t*)0, pivcol, pivots, ctx,
+                                 space);
+                }
 
-        for (size_t i=1; i<=rows1; i+=BLOCK_SIZE) {
-                g_thread_pool_push(pool, (void*)i, &error);
-                checkGError("g_thread_pool_push", error);
+                // clear the pivot columns from the rows above and below
+                const size_t o0[2] = { 0, rank + r };
+                const size_t ol[2] = { rank, nrows };
+                for (int s=0; s<2; ++s)
+                {
+                        const size_t rows = ol[s] - o0[s];
+                        if (!rows) continue;
+
+                        Matrix x(rows, r);
+                        for (size_t i=0; i<rows; ++i)
+                                for (size_t u=0; u<r; ++u)
+                                        E(x, i, u) = E(w, o0[s]+i,
+                                                       c0+pivcol[u]);
+
+                        for (int q=0; q<2; ++q)
+                        {
+                                if (!parts[q]) continue;
+                                Matrix &m = *parts[q];
+                                const size_t cols = m.ncols-from[q];
+                                Matrix pivots(A(m, rank, from[q]), r, cols,
+                                              m.stride);
+                                Matrix others(A(m, o0[s], from[q]), rows,
+                                              cols, m.stride);
+                                pmul_any(x, pivots, others, ctx, true);
+                        }
+                }
+                rank += r;
         }
 
-        g_thread_pool_free(pool, false, true);
+        if (dependent)
+                dependent->assign(perm.begin()+rank, perm.end());
+        return rank;
 }
 
-void pmul_nonblk(const Matrix &m1, const Matrix &m2, Matrix &md)
+template <class Fq>
+size_t invert_rank(const basic_matrix<Fq> &m_in, basic_matrix<Fq> &res,
+                   std::vector<size_t> *dependent, const context &ctx)
 {
-        const size_t rows1 = m1.nrows;
-        struct muldata d = { m1, m2, md };
-        GError *error = 0;
+        typedef basic_matrix<Fq> Matrix;
+        const size_t n = m_in.nrows;
 
-        GThreadPool *pool = g_thread_pool_new(mulrow_nonblk, &d,
-                                              NCPUS, true, &error);
-        checkGError("g_thread_pool_create", error);
-
-        set_zero(md);
+        if (ctx.invert_block && n > ctx.invert_block)
+        {
+                // [m|I], so that the right half ends up as the inverse
+                Matrix w(n, 2*n, true);
+                copy(m_in, w);
+                for (size_t i=0; i<n; ++i)
+                        E(w, i, n+i) = 1;
 
-        for (size_t i=1; i<=rows1; ++i) {
-                g_thread_pool_push(pool, (void*)i, &error);
-                checkGError("g_thread_pool_push", error);
+                const size_t rank = reduce_blocked(w, n, (Matrix*)0,
+                                                   dependent, ctx);
+                if (rank == n)
+                        copy(Matrix(A(w, 0, n), n, n, w.stride), res);
+                return rank;
         }
 
-        g_thread_pool_free(pool, false, true);
+        Matrix m(n, n);
+        copy(m_in, m);
+        set_identity(res);
+        return reduce(m, res, dependent, ctx);
+}
+
+template <class Fq>
+size_t decode(basic_matrix<Fq> &coefs, basic_matrix<Fq> &data,
+              std::vector<size_t> *dependent)
+{
+        return decode(coefs, data, dependent, context());
+}
+
+template <class Fq>
+size_t decode(basic_matrix<Fq> &coefs, basic_matrix<Fq> &data,
+              std::vector<size_t> *dependent, const context &ctx)
+{
+        if (ctx.invert_block && coefs.ncols > ctx.invert_block)
+                return reduce_blocked(coefs, coefs.ncols, &data,
+                                      dependent, ctx);
+        return reduce(coefs, data, dependent, ctx);
+}
+
+/** \brief Tiles of a batch of products: tiles [first[g], first[g+1]) are
+    the ones of product \c g, \c tcols[g] columns wide
+ */
+template <class Fq>
+struct batchdata
+{
+        /// \brief The products
+        const std::vector<mul_job<Fq> > &batch;
+        /// \brief First tile of each product, and the end
+        std::vector<size_t> first;
+        /// \brief Columns of a tile of each product
+        std::vector<size_t> tcols;
+        /// \brief Settings of the operation
+        const context &ctx;
+};
+
+/// \brief Task of #pmul_batch: the \c t th tile of the batch
+template <class Fq>
+void multile_batch(size_t t, void *d)
+{
+        batchdata<Fq> *data = reinterpret_cast<batchdata<Fq>*>(d);
+        const size_t g = std::upper_bound(data->first.begin(),
+                                          data->first.end(), t)
+                - data->first.begin() - 1;
+        const mul_job<Fq> &job = data->batch[g];
+        const size_t j0 = (t - data->first[g]) * data->tcols[g];
+        mul_panels(*job.m1, *job.m2, *job.md, 0, job.m1->nrows,
+                   j0, std::min(j0 + data->tcols[g], job.m2->ncols),
+                   data->ctx);
+}
+
+template <class Fq>
+void pmul_batch(const std::vector<mul_job<Fq> > &batch)
+{
+        pmul_batch(batch, context());
 }
 
-void pmul(const Matrix &m1, const Matrix &m2, Matrix &md)
+template <class Fq>
+void pmul_batch(const std::vector<mul_job<Fq> > &batch, const context &ctx)
 {
-        if (NCPUS == 1)
+        typedef basic_matrix<Fq> Matrix;
+        typedef typename Matrix::Element Element;
+        const size_t n = batch.size();
+        if (!n) return;
+
+        // As many tiles per product as needed for TILES_PER_THREAD per
+        // thread in all, but not narrower than tile_min_row_bytes
+        const size_t unit = Matrix::ALIGNMENT / sizeof(Element);
+        const size_t per = (TILES_PER_THREAD * ctx.ncpus + n - 1) / n;
+        const size_t mincols = ctx.tile_min_row_bytes / sizeof(Element);
+        batchdata<Fq> d = { batch, std::vector<size_t>(n + 1, 0),
+                            std::vector<size_t>(n, 1), ctx };
+        for (size_t g=0; g<n; ++g)
         {
-                mul(m1, m2, md);
+                const size_t cols2 = batch[g].m2->ncols;
+                size_t tiles = 0;
+                if (cols2 && batch[g].m1->nrows)
+                {
+                        size_t tcols = std::max((cols2 + per - 1) / per,
+                                                mincols);
+                        tcols = std::min(std::max(tcols / unit, size_t(1))
+                                         * unit, cols2);
+                        d.tcols[g] = tcols;
+                        tiles = (cols2 + tcols - 1) / tcols;
+                }
+                d.first[g+1] = d.first[g] + tiles;
         }
-        else
+        pool::run(multile_batch<Fq>, &d, d.first[n], ctx.ncpus);
+}
+
+/// \brief Generations of #decode_batch, decoded by a thread each
+template <class Fq>
+struct decodedata
+{
+        /// \brief The generations
+        std::vector<decode_job<Fq> > &batch;
+        /// \brief Settings of the decoding of a generation
+        const context &ctx;
+};
+
+/// \brief Task of #decode_batch: the \c g th generation
+template <class Fq>
+void decode_generation(size_t g, void *d)
+{
+        decodedata<Fq> *data = reinterpret_cast<decodedata<Fq>*>(d);
+        decode_job<Fq> &job = data->batch[g];
+        job.rank = decode(*job.coefs, *job.data, job.dependent, data->ctx);
+}
+
+template <class Fq>
+void decode_batch(std::vector<decode_job<Fq> > &batch)
+{
+        decode_batch(batch, context());
+}
+
+template <class Fq>
+void decode_batch(std::vector<decode_job<Fq> > &batch, const context &ctx)
+{
+        if (ctx.ncpus > 1 && batch.size() >= size_t(ctx.ncpus))
         {
-                if (BLOCK_SIZE == 1)
-                        pmul_nonblk(m1, m2, md);
-                else
-                        pmul_blk(m1, m2, md);
+                // A task must not use the pool itself
+                context single = ctx;
+                single.ncpus = 1;
+                decodedata<Fq> d = { batch, single };
+                pool::run(decode_generation<Fq>, &d, batch.size(),
+                          ctx.ncpus);
+                return;
         }
+
+        for (size_t g=0; g<batch.size(); ++g)
+                batch[g].rank = decode(*batch[g].coefs, *batch[g].data,
+                                       batch[g].dependent, ctx);
 }
 
+/** \brief Bytes of the elements (i, j) of the matrices of a group of
+    #invert_batch: a vector of the widest SIMD instruction sets
+ */
+static const size_t BATCH_GROUP_BYTES = 64;
+
+/** \brief A group of matrices of #invert_batch, interleaved: element
+    (i, j) of matrix \c l is at <tt>(i*n + j)*L + l</tt>
 
-void mul_nonblk(const Matrix &m1, const Matrix &m2, Matrix &md)
+    Each operation works on the \c L matrices at once, element \c l of a
+    vector belonging to matrix \c l. A product by a factor of each matrix
+    is computed by shifts and additions of the multiples \f$f*2^k\f$ of
+    the factors, so that the inner loops are over the \c L matrices with
+    no table lookup, and are vectorized by the compiler.
+ */
+template <class Fq>
+struct interleaved
 {
-        const size_t rows1 = m1.nrows;
-        const size_t cols1 = m1.ncols;
-        const size_t cols2 = m2.ncols;
-        for (size_t i=0; i<rows1; ++i)
-                for (size_t j=0; j<cols2; ++j)
+        typedef typename Fq::fq_t Element;
+        /// \brief Matrices of the group
+        static const size_t L = BATCH_GROUP_BYTES / sizeof(Element);
+        /// \brief Bits of an element
+        static const size_t W = 8 * sizeof(Element);
+
+        /// \brief \f$f*2^k\f$ for each factor \c f of #set
+        Element basis[W][L];
+
+        /// \brief Set the factor of each matrix
+        void set(const Element *f) {
+                const Element poly = Element(Fq::polynomial);
+                for (size_t l=0; l<L; ++l)
+                        basis[0][l] = f[l];
+                for (size_t k=1; k<W; ++k)
+                        for (size_t l=0; l<L; ++l)
+                        {
+                                const Element b = basis[k-1][l];
+                                basis[k][l] = Element(b << 1)
+                                        ^ (Element(0 - (b >> (W - 1)))
+                                           & poly);
+                        }
+        }
+
+        /** \brief \f$dst_j := f*src_j\f$, or \f$dst_j := dst_j+f*src_j\f$
+            if \c add, for the \c len vectors \c j; \c dst may be \c src
+         */
+        void mul(Element *dst, const Element *src, size_t len,
+                 bool add) const {
+                for (size_t j=0; j<len; ++j, dst += L, src += L)
                 {
-                        Element s = 0;
-                        for (size_t k=0; k<cols1; ++k)
-                                addto_mul(s, E(m1,i,k), E(m2,k,j));
-                        E(md,i,j) = s;
+                        Element acc[L];
+                        for (size_t l=0; l<L; ++l)
+                                acc[l] = add ? dst[l] : 0;
+                        for (size_t k=0; k<W; ++k)
+                                for (size_t l=0; l<L; ++l)
+                                        acc[l] ^= Element(
+                                                0 - ((src[l] >> k) & 1))
+                                                & basis[k][l];
+                        for (size_t l=0; l<L; ++l)
+                                dst[l] = acc[l];
                 }
+        }
+};
 
+/** \brief Largest matrices #invert_batch interleaves
+
+    Beyond, #invert of each matrix is faster: the region kernels cost less
+    per element than the \c W passes of interleaved::mul. Measured at about
+    12 rows over GF(2^8), 48 over GF(2^16), whose kernels are dear to
+    prepare, and 20 over GF(2^32).
+ */
+template <class Fq>
+static size_t batch_order_max()
+{
+        switch (sizeof(typename Fq::fq_t))
+        {
+        case 1: return 12;
+        case 2: return 48;
+        default: return 20;
+        }
 }
 
-void mul_blk(const Matrix &m1, const Matrix &m2, Matrix &md)
+/// \brief Matrices of #invert_batch
+template <class Fq>
+struct batchinv
 {
-        size_t i, j, k, i0,j0,k0, li, lj, lk;
+        const basic_matrix<Fq> &m;
+        basic_matrix<Fq> &res;
+        /// \brief Size of the matrices
+        size_t n;
+        /// \brief Number of matrices
+        size_t count;
+        /// \brief Whether the matrices are interleaved, or inverted one by one
+        bool interleave;
+        /// \brief Groups of interleaved matrices, or matrices, to invert
+        size_t units;
+        /// \brief Number of tasks the units are split into
+        size_t tasks;
+        /// \brief Settings of the matrices inverted one by one
+        context ctx;
+        /// \brief Whether each matrix is singular
+        std::vector<char> singular;
+};
 
-        const size_t cols1 = m1.ncols;
-        const size_t cols2 = m2.ncols;
-        const size_t rows1 = m1.nrows;
+/** \brief Gauss-Jordan elimination of the \c g th group of matrices,
+    interleaved in the work areas \c a and \c r of \f$n*n*L\f$ elements
+
+    The pivot of a column is searched and swapped matrix by matrix, the
+    rows are normalized and eliminated on all the matrices at once. The
+    missing matrices of the last group are identities. A singular matrix
+    gets a null factor at its first missing pivot, and goes on harmlessly
+    with the others.
+ */
+template <class Fq>
+static void invert_group(batchinv<Fq> *data, size_t g,
+                         typename Fq::fq_t *a, typename Fq::fq_t *r)
+{
+        typedef typename Fq::fq_t Element;
+        typedef interleaved<Fq> Group;
+        const size_t L = Group::L;
+        const size_t n = data->n;
+
+        std::fill(a, a + n*n*L, Element(0));
+        std::fill(r, r + n*n*L, Element(0));
+        for (size_t l=0; l<L; ++l)
+        {
+                const size_t b = g*L + l;
+                for (size_t i=0; i<n; ++i)
+                {
+                        r[(i*n + i)*L + l] = 1;
+                        if (b >= data->count)
+                                a[(i*n + i)*L + l] = 1;
+                        else
+                                for (size_t j=0; j<n; ++j)
+                                        a[(i*n + j)*L + l] =
+                                                E(data->m, b*n + i, j);
+                }
+        }
 
-        Row *r = md.rows;
-        const size_t rowsize = cols2 * sizeof(Element);
-        for (i=0; i<rows1; ++i, ++r)
-                memset(*r, 0, rowsize);
-
-        for (i=0, li=BLOCK_SIZE; i<rows1; li+=BLOCK_SIZE, i+=BLOCK_SIZE) {
-                if (li > rows1) li=rows1;
-                for (k=0, lk=BLOCK_SIZE; k<cols1; lk+=BLOCK_SIZE, k+=BLOCK_SIZE) {
-                        if (lk > cols1) lk=cols1;
-
-                        for (j=0, lj=BLOCK_SIZE; j<cols2; lj+=BLOCK_SIZE, j+=BLOCK_SIZE) {
-                                if (lj > cols2) lj=cols2;
-
-                                for (i0=i; i0<li; ++i0) {
-                                        for (k0=k; k0<lk; ++k0) {
-                                                const Element e1 =  E(m1, i0, k0);
-                                                for (j0=j; j0<lj; ++j0) {
-                                                        addto_mul(E(md, i0, j0),
-                                                                  e1,
-                                                                  E(m2, k0, j0));
-                                                }
-                                        }
-                                }
+        Group op;
+        bool singular[L] = { false };
+        Element f[L], pre[L];
+        for (size_t c=0; c<n; ++c)
+        {
+                Element *ac = &a[(c*n + c)*L], *rc = &r[c*n*L];
+                for (size_t l=0; l<L; ++l)
+                {
+                        size_t p = c;
+                        while (p < n && a[(p*n + c)*L + l] == 0) ++p;
+                        if (p == n)
+                        {
+                                singular[l] = true;
+                                continue;
                         }
+                        if (p == c) continue;
+                        for (size_t j=c; j<n; ++j)
+                                std::swap(a[(p*n + j)*L + l],
+                                          a[(c*n + j)*L + l]);
+                        for (size_t j=0; j<n; ++j)
+                                std::swap(r[(p*n + j)*L + l],
+                                          r[(c*n + j)*L + l]);
+                }
+
+                // All the pivots inverted at once, from their products
+                // pre[l] = ac[0]*...*ac[l]: a single Fq::inv, which is
+                // far dearer than a product in GF(2^32)
+                for (size_t l=0; l<L; ++l)
+                {
+                        const Element x = ac[l] ? ac[l] : 1;
+                        pre[l] = l ? Fq::mul(pre[l-1], x) : x;
+                }
+                Element inv = Fq::inv(pre[L-1]);
+                for (size_t l=L-1; l>0; --l)
+                {
+                        f[l] = ac[l] ? Fq::mul(inv, pre[l-1]) : 0;
+                        if (ac[l]) inv = Fq::mul(inv, ac[l]);
+                }
+                f[0] = ac[0] ? inv : 0;
+                op.set(f);
+                op.mul(ac, ac, n - c, false);
+                op.mul(rc, rc, n, false);
+
+                for (size_t i=0; i<n; ++i)
+                {
+                        if (i == c) continue;
+                        Element *ai = &a[(i*n + c)*L];
+                        Element any = 0;
+                        for (size_t l=0; l<L; ++l)
+                                any |= f[l] = ai[l];
+                        if (!any) continue;
+                        op.set(f);
+                        op.mul(ai, ac, n - c, true);
+                        op.mul(&r[i*n*L], rc, n, true);
                 }
         }
+
+        for (size_t l=0; l<L && g*L + l < data->count; ++l)
+        {
+                const size_t b = g*L + l;
+                data->singular[b] = singular[l];
+                for (size_t i=0; i<n; ++i)
+                        for (size_t j=0; j<n; ++j)
+                                E(data->res, b*n + i, j) =
+                                        r[(i*n + j)*L + l];
+        }
 }
 
-// (rows1 x cols1) * (cols1 x cols2) = (rows1 x cols2)
-void mul(const Matrix &m1, const Matrix &m2, Matrix &md)
+/** \brief Task of #invert_batch: the \c t th share of the units
+
+    The work areas are allocated once per task, not per unit.
+ */
+template <class Fq>
+void invert_units(size_t t, void *d)
 {
-        if (BLOCK_SIZE == 1)
-                mul_nonblk(m1, m2, md);
-        else
-                mul_blk(m1, m2, md);
+        typedef basic_matrix<Fq> Matrix;
+        typedef typename Fq::fq_t Element;
+        batchinv<Fq> *data = reinterpret_cast<batchinv<Fq>*>(d);
+        const size_t n = data->n;
+        const size_t u0 = t * data->units / data->tasks;
+        const size_t lu = (t+1) * data->units / data->tasks;
+
+        if (data->interleave)
+        {
+                const size_t size = n*n*interleaved<Fq>::L;
+                std::vector<Element> a(size), r(size);
+                for (size_t g=u0; g<lu; ++g)
+                        invert_group(data, g, &a[0], &r[0]);
+                return;
+        }
+
+        Matrix w(n, n);
+        reduce_space<Fq> space(Fq::region(*data->ctx.kernel), n, n);
+        for (size_t b=u0; b<lu; ++b)
+        {
+                // res may be m: the matrix is copied first
+                copy(Matrix(RA(data->m, b*n), n, n, data->m.stride), w);
+                Matrix rb(RA(data->res, b*n), n, n, data->res.stride);
+                set_identity(rb);
+                data->singular[b] = reduce(w, rb, (std::vector<size_t>*)0,
+                                           data->ctx, space) < n;
+        }
+}
+
+template <class Fq>
+size_t invert_batch(const basic_matrix<Fq> &m, basic_matrix<Fq> &res,
+                    std::vector<size_t> *singular)
+{
+        return invert_batch(m, res, singular, context());
+}
+
+template <class Fq>
+size_t invert_batch(const basic_matrix<Fq> &m, basic_matrix<Fq> &res,
+                    std::vector<size_t> *singular, const context &ctx)
+{
+        const size_t L = interleaved<Fq>::L;
+        const size_t n = m.ncols;
+        const size_t count = n ? m.nrows / n : 0;
+        const bool interleave = n <= batch_order_max<Fq>();
+        const size_t units = interleave ? (count + L - 1) / L : count;
+        const size_t tasks = std::min(units, size_t(std::max(ctx.ncpus, 1)));
+        if (!tasks) return 0;
+
+        // each task inverts its matrices alone
+        context single = ctx;
+        single.ncpus = 1;
+        batchinv<Fq> d = { m, res, n, count, interleave, units, tasks,
+                           single, std::vector<char>(count, 0) };
+        pool::run(invert_units<Fq>, &d, tasks, ctx.ncpus);
+
+        size_t inverted = count;
+        for (size_t b=0; b<count; ++b)
+        {
+                if (!d.singular[b]) continue;
+                --inverted;
+                if (singular) singular->push_back(b);
+        }
+        return inverted;
+}
+
+template <class Fq>
+void rand_matr(basic_matrix<Fq> &m, random::mt_state *rnd_state)
+{
+        MATRIX_TYPES(Fq);
+        CACHE_DIMS(m);
+
+        Row row = m.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride)
+        {
+                Element *elem = row;
+                for (size_t j=0; j<ncols; ++j, ++elem)
+                        *elem = Element(random::generate(rnd_state));
+        }
+}
+
+template <class Fq>
+void set_identity(basic_log_matrix<Fq> &m) throw()
+{
+        MATRIX_TYPES(Fq);
+        CACHE_DIMS(m);
+
+        Row row = m.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride)
+        {
+                Element *elem = row;
+                for (size_t j=0; j<ncols; ++j, ++elem)
+                        *elem = i==j ? 0 : Fq::log_zero;
+        }
+}
+
+template <class Fq>
+void set_zero(basic_log_matrix<Fq> &m) throw()
+{
+        MATRIX_TYPES(Fq);
+        CACHE_DIMS(m);
+
+        Row row = m.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride)
+        {
+                Element *elem = row;
+                for (size_t j=0; j<ncols; ++j, ++elem)
+                        *elem = Fq::log_zero;
+        }
+}
+
+template <class Fq>
+void to_log(const basic_matrix<Fq> &m, basic_log_matrix<Fq> &md) throw()
+{
+        MATRIX_TYPES(Fq);
+        CACHE_DIMS(m);
+
+        Row row = m.data, rowD = md.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride, rowD += md.stride)
+        {
+                const Element *elem = row;
+                Element *elemD = rowD;
+                for (size_t j=0; j<ncols; ++j, ++elem, ++elemD)
+                        *elemD = Fq::to_log(*elem);
+        }
+}
+
+template <class Fq>
+void from_log(const basic_log_matrix<Fq> &m, basic_matrix<Fq> &md) throw()
+{
+        MATRIX_TYPES(Fq);
+        CACHE_DIMS(m);
+
+        Row row = m.data, rowD = md.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride, rowD += md.stride)
+        {
+                const Element *elem = row;
+                Element *elemD = rowD;
+                for (size_t j=0; j<ncols; ++j, ++elem, ++elemD)
+                        *elemD = Fq::from_log(*elem);
+        }
+}
+
+template <class Fq>
+bool invert(const basic_matrix<Fq> &m_in, basic_log_matrix<Fq> &res)
+{
+        return invert(m_in, res, context());
+}
+
+template <class Fq>
+bool invert(const basic_matrix<Fq> &m_in, basic_log_matrix<Fq> &res,
+            const context &ctx)
+{
+        basic_matrix<Fq> r(res.data, res.nrows, res.ncols, res.stride);
+        if (!invert(m_in, r, ctx)) return false;
+        to_log(r, res);
+        return true;
+}
+
+template <class Fq>
+bool invert(const basic_log_matrix<Fq> &m_in,
+            basic_log_matrix<Fq> &res)
+{
+        return invert(m_in, res, context());
+}
+
+template <class Fq>
+bool invert(const basic_log_matrix<Fq> &m_in, basic_log_matrix<Fq> &res,
+            const context &ctx)
+{
+        basic_matrix<Fq> m(m_in.nrows, m_in.ncols);
+        from_log(m_in, m);
+        return invert(m, res, ctx);
 }
 
-void rand_matr(Matrix &m, random::mt_state *rnd_state)
+template <class Fq>
+void mul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+         basic_matrix<Fq> &md)
 {
+        mul_any(m1, m2, md, context());
+}
+
+template <class Fq>
+void mul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+         basic_matrix<Fq> &md, const context &ctx)
+{
+        mul_any(m1, m2, md, ctx);
+}
+
+template <class Fq>
+void pmul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+          basic_matrix<Fq> &md)
+{
+        pmul_any(m1, m2, md, context());
+}
+
+template <class Fq>
+void pmul(const basic_log_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+          basic_matrix<Fq> &md, const context &ctx)
+{
+        pmul_any(m1, m2, md, ctx);
+}
+
+template <class Fq>
+void rand_matr(basic_log_matrix<Fq> &m, random::mt_state *rnd_state)
+{
+        MATRIX_TYPES(Fq);
         CACHE_DIMS(m);
 
-        Row *row = m.rows;
-        for (size_t i=0; i<nrows; ++i, ++row)
+        Row row = m.data;
+        for (size_t i=0; i<nrows; ++i, row += m.stride)
         {
-                Element *elem = *row;
+                Element *elem = row;
                 for (size_t j=0; j<ncols; ++j, ++elem)
-                        *elem = random::generate_fq(rnd_state);
+                {
+                        // 0 stands for zero, v for the element g^(v-1)
+                        const Element v =
+                                Element(random::generate(rnd_state) % Fq::size);
+                        *elem = v ? v-1 : Fq::log_zero;
+                }
+        }
+}
+
+
+/// \brief Whether the columns of each row of \c m are strictly ascending
+template <class Fq>
+static bool ordered(const basic_sparse_matrix<Fq> &m)
+{
+        for (size_t i=0; i<m.nrows; ++i)
+                for (size_t e=m.row_start[i]+1; e<m.row_start[i+1]; ++e)
+                        if (m.col[e-1] >= m.col[e]) return false;
+        return true;
+}
+
+template <class Fq>
+void copy(const basic_sparse_matrix<Fq> &m, basic_matrix<Fq> &md) throw()
+{
+        assert(ordered(m));
+        set_zero(md);
+        for (size_t i=0; i<m.nrows; ++i)
+                for (size_t e=m.row_start[i]; e<m.row_start[i+1]; ++e)
+                        E(md, i, m.col[e]) = m.val[e];
+}
+
+template <class Fq>
+void mul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+         basic_matrix<Fq> &md)
+{
+        mul(m1, m2, md, context());
+}
+
+template <class Fq>
+void mul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+         basic_matrix<Fq> &md, const context &ctx)
+{
+        assert(ordered(m1));
+        mul_any(m1, m2, md, ctx);
+}
+
+template <class Fq>
+void pmul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+          basic_matrix<Fq> &md)
+{
+        pmul(m1, m2, md, context());
+}
+
+template <class Fq>
+void pmul(const basic_sparse_matrix<Fq> &m1, const basic_matrix<Fq> &m2,
+          basic_matrix<Fq> &md, const context &ctx)
+{
+        assert(ordered(m1));
+        pmul_any(m1, m2, md, ctx);
+}
+
+template <class Fq>
+void rand_matr(basic_sparse_matrix<Fq> &m, double density,
+               random::mt_state *rnd_state)
+{
+        typedef typename Fq::fq_t Element;
+
+        m.col.clear();
+        m.val.clear();
+        for (size_t i=0; i<m.nrows; ++i)
+        {
+                m.row_start[i] = m.col.size();
+                for (size_t j=0; j<m.ncols; ++j)
+                        if (random::generateP(rnd_state) < density)
+                                m.col.push_back(j);
+                if (m.col.size() == m.row_start[i] && m.ncols)
+                        m.col.push_back(random::generate(rnd_state)
+                                        % m.ncols);
+
+                while (m.val.size() < m.col.size())
+                {
+                        const Element v = Element(random::generate(rnd_state));
+                        if (v) m.val.push_back(v);
+                }
+        }
+        m.row_start[m.nrows] = m.col.size();
+}
+
+template <class Fq>
+size_t decode(const basic_sparse_matrix<Fq> &coefs, basic_matrix<Fq> &data,
+              std::vector<size_t> *dependent)
+{
+        return decode(coefs, data, dependent, context());
+}
+
+/** \brief Element (r, c) of the sparse \c m, known to be non-zero
+
+    Found by binary search, the columns of the row being ascending.
+ */
+template <class Fq>
+static inline typename Fq::fq_t nonzero(const basic_sparse_matrix<Fq> &m,
+                                        size_t r, size_t c)
+{
+        const size_t *col = m.col.data();
+        return m.val[std::lower_bound(col + m.row_start[r],
+                                      col + m.row_start[r+1], c) - col];
+}
+
+template <class Fq>
+size_t decode(const basic_sparse_matrix<Fq> &coefs, basic_matrix<Fq> &data,
+              std::vector<size_t> *dependent, const context &ctx)
+{
+        MATRIX_TYPES(Fq);
+        static const size_t NONE = ~size_t(0);
+        const size_t nrows = coefs.nrows;
+        const size_t n = coefs.ncols;
+        const size_t ncols = data.ncols;
+        const kernel_set &k = *ctx.kernel;
+
+        assert(ordered(coefs));
+
+        std::vector<size_t> dep;
+
+        // The rows of each column
+        std::vector<size_t> cstart(n + 1, 0), crows(coefs.nnz());
+        for (size_t e=0; e<coefs.nnz(); ++e)
+                ++cstart[coefs.col[e] + 1];
+        for (size_t j=0; j<n; ++j)
+                cstart[j+1] += cstart[j];
+        {
+                std::vector<size_t> next(cstart.begin(), cstart.end() - 1);
+                for (size_t i=0; i<nrows; ++i)
+                        for (size_t e=coefs.row_start[i];
+                             e<coefs.row_start[i+1]; ++e)
+                                crows[next[coefs.col[e]]++] = i;
+        }
+
+        // Peeling: a row with a single unknown left solves it, which is
+        // then substituted into the other rows of its column
+        std::vector<size_t> weight(nrows), solved(n, NONE), ready;
+        std::vector<char> done(nrows, 0);
+        for (size_t i=0; i<nrows; ++i)
+        {
+                weight[i] = coefs.nnz(i);
+                if (weight[i] == 1)
+                        ready.push_back(i);
+                else if (!weight[i])
+                {
+                        done[i] = 1;
+                        dep.push_back(i);
+                }
+        }
+
+        size_t rank = 0;
+        while (!ready.empty())
+        {
+                const size_t i = ready.back();
+                ready.pop_back();
+                if (done[i]) continue;
+
+                size_t e = coefs.row_start[i];
+                while (solved[coefs.col[e]] != NONE) ++e;
+                const size_t j = coefs.col[e];
+                Row const row = RA(data, i);
+                Fq::mul_region(k, row, row, Fq::inv(coefs.val[e]), ncols);
+                solved[j] = i;
+                done[i] = 1;
+                ++rank;
+
+                for (size_t t=cstart[j]; t<cstart[j+1]; ++t)
+                {
+                        const size_t r = crows[t];
+                        if (done[r]) continue;
+
+                        Fq::addto_mul_region(k, RA(data, r), row,
+                                             nonzero(coefs, r, j), ncols);
+                        if (--weight[r] == 1)
+                                ready.push_back(r);
+                        else if (!weight[r])
+                        {
+                                done[r] = 1;
+                                dep.push_back(r);
+                        }
+                }
+        }
+
+        // The rest is decoded as a dense system: the unknowns left are its
+        // columns, the rows left its rows, zero rows padding it to square
+        std::vector<size_t> unknown(n, NONE), left;
+        size_t u = 0;
+        for (size_t j=0; j<n; ++j)
+                if (solved[j] == NONE) unknown[j] = u++;
+        for (size_t i=0; i<nrows; ++i)
+                if (!done[i]) left.push_back(i);
+
+        const size_t m = std::max(left.size(), u);
+        Matrix a(m, u, true);
+        Matrix d(m, ncols, true);
+        if (u)
+        {
+                for (size_t t=0; t<left.size(); ++t)
+                {
+                        const size_t i = left[t];
+                        for (size_t e=coefs.row_start[i];
+                             e<coefs.row_start[i+1]; ++e)
+                                if (unknown[coefs.col[e]] != NONE)
+                                        E(a, t, unknown[coefs.col[e]]) =
+                                                coefs.val[e];
+                        memcpy(RA(d, t), RA(data, i), ncols*sizeof(Element));
+                }
+
+                std::vector<size_t> ddep;
+                rank += decode(a, d, &ddep, ctx);
+                for (size_t t=0; t<ddep.size(); ++t)
+                        if (ddep[t] < left.size())
+                                dep.push_back(left[ddep[t]]);
+        }
+
+        if (rank == n)
+        {
+                // The sources are scattered among the rows: source j is
+                // moved from row solved[j] to row j in place, along the
+                // chains and cycles this permutation forms
+                const size_t size = ncols*sizeof(Element);
+                std::vector<char> needed(nrows, 0), placed(n, 0);
+                for (size_t j=0; j<n; ++j)
+                        if (solved[j] != NONE) needed[solved[j]] = 1;
+
+                // A chain ends at a row not needed: moved from its end back
+                for (size_t j=0; j<n; ++j)
+                {
+                        if (needed[j]) continue;
+                        for (size_t c=j; c<n && solved[c] != NONE;
+                             c=solved[c])
+                        {
+                                memcpy(RA(data, c), RA(data, solved[c]),
+                                       size);
+                                placed[c] = 1;
+                        }
+                }
+
+                // The rows left form cycles, each rotated through a row of
+                // scratch
+                std::vector<Element> first;
+                for (size_t j=0; j<n; ++j)
+                {
+                        if (placed[j] || solved[j] == NONE) continue;
+                        placed[j] = 1;
+                        if (solved[j] == j) continue;
+
+                        first.assign(RA(data, j), RA(data, j) + ncols);
+                        size_t c = j;
+                        for (; solved[c] != j; c=solved[c])
+                        {
+                                memcpy(RA(data, c), RA(data, solved[c]),
+                                       size);
+                                placed[c] = 1;
+                        }
+                        memcpy(RA(data, c), &first[0], size);
+                        placed[c] = 1;
+                }
+
+                // The sources of the dense system
+                for (size_t j=0; j<n; ++j)
+                        if (solved[j] == NONE)
+                                memcpy(RA(data, j), RA(d, unknown[j]), size);
         }
+
+        if (dependent)
+        {
+                std::sort(dep.begin(), dep.end());
+                dependent->swap(dep);
+        }
+        return rank;
 }
 
+
+#define INSTANTIATE(Fq)                                                 \
+        template void set_identity(basic_matrix<Fq> &m) throw();        \
+        template void set_zero(basic_matrix<Fq> &m) throw();            \
+        template void copy(const basic_matrix<Fq> &m,                   \
+                           basic_matrix<Fq> &md) throw();               \
+        template void copy(const basic_matrix<Fq> &m,                   \
+                           basic_matrix<Fq>::Element* dest) throw();    \
+        template bool invert(const basic_matrix<Fq> &m_in,              \
+                             basic_matrix<Fq> &res);                    \
+        template bool invert(const basic_matrix<Fq> &m_in,              \
+                             basic_matrix<Fq> &res,                     \
+                             const context &ctx);                       \
+        template size_t invert_rank(const basic_matrix<Fq> &m_in,       \
+                                    basic_matrix<Fq> &res,              \
+                                    std::vector<size_t> *dependent);    \
+        template size_t invert_rank(const basic_matrix<Fq> &m_in,       \
+                                    basic_matrix<Fq> &res,              \
+                                    std::vector<size_t> *dependent,     \
+                                    const context &ctx);                \
+        template size_t decode(basic_matrix<Fq> &coefs,                 \
+                               basic_matrix<Fq> &data,                  \
+                               std::vector<size_t> *dependent);         \
+        template size_t decode(basic_matrix<Fq> &coefs,                 \
+                               basic_matrix<Fq> &data,                  \
+                               std::vector<size_t> *dependent,          \
+                               const context &ctx);                     \
+        template void mul(const basic_matrix<Fq> &m1,                   \
+                          const basic_matrix<Fq> &m2,                   \
+                          basic_matrix<Fq> &md);                        \
+        template void mul(const basic_matrix<Fq> &m1,                   \
+                          const basic_matrix<Fq> &m2,                   \
+                          basic_matrix<Fq> &md,                         \
+                          const context &ctx);                          \
+        template void pmul(const basic_matrix<Fq> &m1,                  \
+                           const basic_matrix<Fq> &m2,                  \
+                           basic_matrix<Fq> &md);                       \
+        template void pmul(const basic_matrix<Fq> &m1,                  \
+                           const basic_matrix<Fq> &m2,                  \
+                           basic_matrix<Fq> &md,                        \
+                           const context &ctx);                         \
+        template void rand_matr(basic_matrix<Fq> &m,                    \
+                                random::mt_state *rnd_state);           \
+        template void copy(const basic_sparse_matrix<Fq> &m,            \
+                           basic_matrix<Fq> &md) throw();               \
+        template void mul(const basic_sparse_matrix<Fq> &m1,            \
+                          const basic_matrix<Fq> &m2,                   \
+                          basic_matrix<Fq> &md);                        \
+        template void mul(const basic_sparse_matrix<Fq> &m1,            \
+                          const basic_matrix<Fq> &m2,                   \
+                          basic_matrix<Fq> &md,                         \
+                          const context &ctx);                          \
+        template void pmul(const basic_sparse_matrix<Fq> &m1,           \
+                           const basic_matrix<Fq> &m2,                  \
+                           basic_matrix<Fq> &md);                       \
+        template void pmul(const basic_sparse_matrix<Fq> &m1,           \
+                           const basic_matrix<Fq> &m2,                  \
+                           basic_matrix<Fq> &md,                        \
+                           const context &ctx);                         \
+        template void rand_matr(basic_sparse_matrix<Fq> &m,             \
+                                double density,                         \
+                                random::mt_state *rnd_state);           \
+        template size_t decode(const basic_sparse_matrix<Fq> &coefs,    \
+                               basic_matrix<Fq> &data,                  \
+                               std::vector<size_t> *dependent);         \
+        template size_t decode(const basic_sparse_matrix<Fq> &coefs,    \
+                               basic_matrix<Fq> &data,                  \
+                               std::vector<size_t> *dependent,          \
+                               const context &ctx);                     \
+        template void pmul_batch(                                       \
+                const std::vector<mul_job<Fq> > &batch);                \
+        template void pmul_batch(                                       \
+                const std::vector<mul_job<Fq> > &batch,                 \
+                const context &ctx);                                    \
+        template void decode_batch(                                     \
+                std::vector<decode_job<Fq> > &batch);                   \
+        template void decode_batch(                                     \
+                std::vector<decode_job<Fq> > &batch,                    \
+                const context &ctx);                                    \
+        template size_t invert_batch(const basic_matrix<Fq> &m,         \
+                                     basic_matrix<Fq> &res,             \
+                                     std::vector<size_t> *singular);    \
+        template size_t invert_batch(const basic_matrix<Fq> &m,         \
+                                     basic_matrix<Fq> &res,             \
+                                     std::vector<size_t> *singular,     \
+                                     const context &ctx)
+
+#define INSTANTIATE_LOG(Fq)                                             \
+        template void set_identity(basic_log_matrix<Fq> &m) throw();    \
+        template void set_zero(basic_log_matrix<Fq> &m) throw();        \
+        template void to_log(const basic_matrix<Fq> &m,                 \
+                             basic_log_matrix<Fq> &md) throw();         \
+        template void from_log(const basic_log_matrix<Fq> &m,           \
+                               basic_matrix<Fq> &md) throw();           \
+        template bool invert(const basic_matrix<Fq> &m_in,              \
+                             basic_log_matrix<Fq> &res);                \
+        template bool invert(const basic_matrix<Fq> &m_in,              \
+                             basic_log_matrix<Fq> &res,                 \
+                             const context &ctx);                       \
+        template bool invert(const basic_log_matrix<Fq> &m_in,          \
+                             basic_log_matrix<Fq> &res);                \
+        template bool invert(const basic_log_matrix<Fq> &m_in,          \
+                             basic_log_matrix<Fq> &res,                 \
+                             const context &ctx);                       \
+        template void mul(const basic_log_matrix<Fq> &m1,               \
+                          const basic_matrix<Fq> &m2,                   \
+                          basic_matrix<Fq> &md);                        \
+        template void mul(const basic_log_matrix<Fq> &m1,               \
+                          const basic_matrix<Fq> &m2,                   \
+                          basic_matrix<Fq> &md,                         \
+                          const context &ctx);                          \
+        template void pmul(const basic_log_matrix<Fq> &m1,              \
+                           const basic_matrix<Fq> &m2,                  \
+                           basic_matrix<Fq> &md);                       \
+        template void pmul(const basic_log_matrix<Fq> &m1,              \
+                           const basic_matrix<Fq> &m2,                  \
+                           basic_matrix<Fq> &md,                        \
+                           const context &ctx);                         \
+        template void rand_matr(basic_log_matrix<Fq> &m,                \
+                                random::mt_state *rnd_state)
+
+INSTANTIATE(Field<GF256>);
+INSTANTIATE(Field<GF65536>);
+INSTANTIATE(Field<GF2_32>);
+INSTANTIATE_LOG(Field<GF256>);
+INSTANTIATE_LOG(Field<GF65536>);
+
 }
 }
@@ -0,0 +1,260 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Implementation of the worker pool specified in rnc-lib/pool.h
+ */
+
+#include <rnc-lib/pool.h>
+#include <glib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <mkstr>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace rnc
+{
+namespace pool
+{
+
+/** \brief Unclaimed tasks [begin, end) of a participant of #run
+
+    Packed into a single word, \f$begin*2^{32}+end\f$, so that the owner
+    taking from the front and thieves taking from the back are both a single
+    compare-and-swap. Padded to a cache line.
+ */
+struct task_range
+{
+        std::atomic<uint64_t> r;
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+
+        static uint64_t pack(uint64_t begin, uint64_t end) {
+                return (begin << 32) | end; }
+};
+
+/** \brief An operation being performed by #run
+
+    The tasks are dealt in contiguous ranges to the participants (the caller
+    and the helpers); a participant that has run out of tasks steals the back
+    half of the range of another one. \c pending counts the helpers pushed to
+    the pool that have not finished. The first exception thrown by a task is
+    kept in \c error, for #run to rethrow.
+ */
+struct batch
+{
+        task_fn task;
+        void *data;
+        std::vector<task_range> ranges;
+        std::atomic<unsigned int> joined; ///< Participants so far
+        gint pending;                     ///< Protected by \c lock
+        GMutex lock;
+        GCond done;
+        std::exception_ptr error;         ///< Protected by \c lock
+        std::atomic<bool> failed;         ///< Whether \c error is set
+
+        batch(size_t nparts) : ranges(nparts), joined(1), failed(false) {}
+};
+
+/// \brief The worker threads; 0 if not started. Protected by #pool_lock.
+static GThreadPool *workers = 0;
+static GMutex pool_lock;
+
+static void checkGError(char const * const context, GError *error)
+{
+        if (error != 0)
+        {
+                std::string ex = MKStr() << "glib error: "
+                                    << context << ": " << error->message;
+                g_error_free(error);
+                throw ex;
+        }
+}
+
+/// \brief Claims the first task of range \c t; false if it is empty
+static bool pop(task_range &t, uint64_t &task)
+{
+        uint64_t r = t.r.load();
+        for (;;)
+        {
+                const uint64_t begin = r >> 32, end = r & 0xffffffff;
+                if (begin >= end) return false;
+                if (t.r.compare_exchange_weak(r, task_range::pack(begin+1, end)))
+                {
+                        task = begin;
+                        return true;
+                }
+        }
+}
+
+/** \brief Moves the back half of the range of another participant to the
+    (empty) range \c self
+
+    \return false, if all the ranges are empty
+ */
+static bool steal(batch *b, size_t self)
+{
+        const size_t n = b->ranges.size();
+        for (size_t k=1; k<n; ++k)
+        {
+                task_range &victim = b->ranges[(self + k) % n];
+                uint64_t r = victim.r.load();
+                for (;;)
+                {
+                        const uint64_t begin = r >> 32, end = r & 0xffffffff;
+                        if (begin >= end) break;
+                        const uint64_t mid = end - (end - begin + 1) / 2;
+                        if (victim.r.compare_exchange_weak(
+                                    r, task_range::pack(begin, mid)))
+                        {
+                                b->ranges[self].r.store(
+                                        task_range::pack(mid, end));
+                                return true;
+                        }
+                }
+        }
+        return false;
+}
+
+/** \brief Performs tasks of \c b as participant \c self until none are left
+
+    An exception of a task is caught, so that it does not cross the frames of
+    glib nor leave the batch while the others use it: it is kept in the
+    batch, and no participant claims tasks anymore.
+ */
+static void work(batch *b, size_t self)
+{
+        uint64_t task;
+        try
+        {
+                do {
+                        while (!b->failed.load()
+                               && pop(b->ranges[self], task))
+                                b->task(task, b->data);
+                } while (!b->failed.load() && steal(b, self));
+        }
+        catch (...)
+        {
+                g_mutex_lock(&b->lock);
+                if (!b->error)
+                        b->error = std::current_exception();
+                g_mutex_unlock(&b->lock);
+                b->failed.store(true);
+        }
+}
+
+static void helper(gpointer bp, gpointer)
+{
+        batch *b = reinterpret_cast<batch*>(bp);
+        work(b, b->joined++);
+
+        g_mutex_lock(&b->lock);
+        if (--b->pending == 0)
+                g_cond_signal(&b->done);
+        g_mutex_unlock(&b->lock);
+}
+
+/// \brief The pool, started or grown to at least \c nthreads workers
+static GThreadPool *get_workers(int nthreads)
+{
+        GError *error = 0;
+
+        g_mutex_lock(&pool_lock);
+        if (!workers)
+                workers = g_thread_pool_new(helper, 0, nthreads, true, &error);
+        else if (g_thread_pool_get_max_threads(workers) < nthreads)
+                g_thread_pool_set_max_threads(workers, nthreads, &error);
+        GThreadPool * const p = workers;
+        g_mutex_unlock(&pool_lock);
+
+        checkGError("g_thread_pool_new", error);
+        return p;
+}
+
+int cpu_count()
+{
+        const long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? int(n) : 1;
+}
+
+void run(task_fn task, void *data, size_t n, int nthreads)
+{
+        if (n == 0) return;
+        const size_t nhelpers =
+                std::min<size_t>(n, std::max(nthreads, 1)) - 1;
+        if (nhelpers == 0)
+        {
+                for (size_t i=0; i<n; ++i)
+                        task(i, data);
+                return;
+        }
+
+        GThreadPool *p = get_workers(nthreads - 1);
+
+        const size_t nparts = nhelpers + 1;
+        batch b(nparts);
+        b.task = task;
+        b.data = data;
+        for (size_t k=0; k<nparts; ++k)
+                b.ranges[k].r.store(task_range::pack(k*n/nparts,
+                                                      (k+1)*n/nparts));
+        b.pending = gint(nhelpers);
+        g_mutex_init(&b.lock);
+        g_cond_init(&b.done);
+
+        GError *error = 0;
+        size_t pushed = 0;
+        for (; pushed<nhelpers; ++pushed)
+        {
+                g_thread_pool_push(p, &b, &error);
+                if (error) break;
+        }
+
+        work(&b, 0);
+
+        // Helpers that could not be pushed will never finish
+        g_mutex_lock(&b.lock);
+        b.pending -= gint(nhelpers - pushed);
+        while (b.pending > 0)
+                g_cond_wait(&b.done, &b.lock);
+        g_mutex_unlock(&b.lock);
+
+        g_cond_clear(&b.done);
+        g_mutex_clear(&b.lock);
+        if (b.error)
+        {
+                if (error) g_error_free(error);
+                std::rethrow_exception(b.error);
+        }
+        checkGError("g_thread_pool_push", error);
+}
+
+void shutdown()
+{
+        g_mutex_lock(&pool_lock);
+        if (workers)
+                g_thread_pool_free(workers, false, true);
+        workers = 0;
+        g_mutex_unlock(&pool_lock);
+}
+
+}
+}
@@ -0,0 +1,1355 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/** \file
+
+    \brief Implementation of the region kernels specified in rnc-lib/field.h
+
+    Multiplying a region by a constant \c c is a linear map over GF(2), so
+    \f$c*x = c*(x_{lo}) + c*(x_{hi}<<4)\f$, where \f$x_{lo}\f$ and
+    \f$x_{hi}\f$ are the low and high nibbles of \c x. The two 16-entry
+    product tables fit in a single SIMD register each, and PSHUFB performs 16
+    (SSSE3), 32 (AVX2) or 64 (AVX-512BW) table lookups in one instruction.
+
+    In the 16 bit field, each symbol is split into four nibbles, and the low
+    and high bytes of the product are looked up separately, requiring eight
+    such tables.
+
+    Every tier is compiled with a function-level \c target attribute, so the
+    library itself needs no \e -m flags; the tiers are bound at run time by
+    kernel.cpp.
+ */
+
+#include <rnc-lib/field.h>
+#include <string.h>
+#include <new>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RNC_X86 1
+#include <immintrin.h>
+#define TARGET(t) __attribute__((target(t)))
+// GCC 12 passes undefined vectors (_mm512_undefined_epi32) as the merge
+// sources of AVX-512 intrinsics, and once they are inlined into a kernel
+// reports them as uninitialized. Silenced around the AVX-512 kernels only.
+#define AVX512_BEGIN                                                    \
+        _Pragma("GCC diagnostic push")                                  \
+        _Pragma("GCC diagnostic ignored \"-Wuninitialized\"")           \
+        _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define AVX512_END _Pragma("GCC diagnostic pop")
+#endif
+
+namespace rnc
+{
+namespace fq
+{
+
+/// \brief Scalar implementation with the logarithm of \c c hoisted.
+template <class F, bool ADD>
+static void region_generic(typename F::fq_t *dst, const typename F::fq_t *src,
+                           typename F::fq_t c, size_t n)
+{
+        typedef typename F::fq_t fq_t;
+
+        if (c == 0)
+        {
+                if (!ADD) memset(dst, 0, n*sizeof(fq_t));
+                return;
+        }
+
+        const int lc = F::tables.log[c];
+        for (size_t i=0; i<n; ++i)
+        {
+                const fq_t s = src[i];
+                fq_t p = 0;
+                if (s)
+                        p = F::tables.pow[lc + F::tables.log[s]];
+                if (ADD) dst[i] ^= p;
+                else dst[i] = p;
+        }
+}
+
+/** \brief Scalar multiply-add with the logarithm of the coefficient given
+
+    One logarithm and one power lookup per non-zero symbol.
+ */
+template <class F>
+static void region_generic_log(typename F::fq_t *dst,
+                               const typename F::fq_t *src,
+                               typename F::fq_t lc, size_t n)
+{
+        for (size_t i=0; i<n; ++i)
+        {
+                const typename F::fq_t s = src[i];
+                if (s)
+                        dst[i] ^= F::tables.pow[lc + F::tables.log[s]];
+        }
+}
+
+/** \brief Multiply-add with the logarithm of the coefficient given, by the
+    kernel \c K taking the coefficient itself
+
+    The coefficient is looked up once per region.
+ */
+template <class F, void (*K)(typename F::fq_t *, const typename F::fq_t *,
+                             typename F::fq_t, size_t)>
+static void region_log(typename F::fq_t *dst, const typename F::fq_t *src,
+                       typename F::fq_t lc, size_t n)
+{
+        K(dst, src, F::tables.pow[lc], n);
+}
+
+/** \brief Handles the trivial coefficients
+
+    \return true, if the operation has been performed.
+ */
+template <bool ADD, class fq_t>
+static inline bool region_trivial(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (c == 0)
+        {
+                if (!ADD) memset(dst, 0, n*sizeof(fq_t));
+                return true;
+        }
+        if (c == 1)
+        {
+                if (ADD)
+                        for (size_t i=0; i<n; ++i)
+                                dst[i] ^= src[i];
+                else if (dst != src)
+                        memmove(dst, src, n*sizeof(fq_t));
+                return true;
+        }
+        return false;
+}
+
+/// \brief #region_ops::prepare: constructs a \c T of the coefficient at \c p
+template <class T, class fq_t>
+static void prepare_as(void *p, fq_t c)
+{
+        new (p) T(c);
+}
+
+/// \brief #region_ops::prepare_log: constructs a \c T of \f$g^{lc}\f$ at \c p
+template <class T, class F>
+static void prepare_pow_as(void *p, typename F::fq_t lc)
+{
+        new (p) T(typename F::fq_t(F::tables.pow[lc]));
+}
+
+/** \brief #region_ops::addto_mul_panel by the kernel \c K, one source
+    region at a time; the prepared coefficient is the coefficient itself
+ */
+template <class fq_t, void (*K)(fq_t *, const fq_t *, fq_t, size_t)>
+static void panel_plain(fq_t *dst, const fq_t * const *src, size_t off,
+                        const void *p, size_t k, size_t n)
+{
+        const fq_t *c = static_cast<const fq_t*>(p);
+        for (size_t t=0; t<k; ++t)
+                K(dst, src[t]+off, c[t], n);
+}
+
+/// \brief Logarithm of a non-zero coefficient, prepared for #panel_generic_log
+template <class F>
+struct log_coef
+{
+        typename F::fq_t lc;
+        /// \brief Of the coefficient \c x, or of \f$g^x\f$ if \c is_log
+        log_coef(typename F::fq_t x, bool is_log = false)
+                : lc(is_log ? x : F::tables.log[x]) {}
+};
+
+/// \brief #region_ops::prepare_log of #panel_generic_log: no lookup at all
+template <class F>
+static void prepare_log_coef(void *p, typename F::fq_t lc)
+{
+        new (p) log_coef<F>(lc, true);
+}
+
+/** \brief Scalar #region_ops::addto_mul_panel
+
+    Four source symbols are added to a destination symbol at a time, so that
+    it is loaded and stored once for each four products.
+ */
+template <class F>
+static void panel_generic_log(typename F::fq_t *dst,
+                              const typename F::fq_t * const *src, size_t off,
+                              const void *p, size_t k, size_t n)
+{
+        typedef typename F::fq_t fq_t;
+        const log_coef<F> *lc = static_cast<const log_coef<F>*>(p);
+        size_t t = 0;
+        for (; t+4 <= k; t+=4)
+        {
+                const fq_t *s0 = src[t]+off, *s1 = src[t+1]+off;
+                const fq_t *s2 = src[t+2]+off, *s3 = src[t+3]+off;
+                const int l0 = lc[t].lc, l1 = lc[t+1].lc;
+                const int l2 = lc[t+2].lc, l3 = lc[t+3].lc;
+                for (size_t i=0; i<n; ++i)
+                {
+                        fq_t d = dst[i];
+                        if (s0[i]) d ^= F::tables.pow[l0 + F::tables.log[s0[i]]];
+                        if (s1[i]) d ^= F::tables.pow[l1 + F::tables.log[s1[i]]];
+                        if (s2[i]) d ^= F::tables.pow[l2 + F::tables.log[s2[i]]];
+                        if (s3[i]) d ^= F::tables.pow[l3 + F::tables.log[s3[i]]];
+                        dst[i] = d;
+                }
+        }
+        for (; t<k; ++t)
+                region_generic_log<F>(dst, src[t]+off, lc[t].lc, n);
+}
+
+/// \brief Portable kernels over GF(2^32)
+namespace gf2_32
+{
+typedef Field<GF2_32> F;
+typedef F::fq_t fq_t;
+
+/** \brief Split-nibble product tables of \c c
+
+    \c t[k][x] = c*(x<<4k) for every nibble \c x. Built from the products
+    \f$c*x^i\f$ by linearity, so the setup costs 128 XORs.
+ */
+struct nibble_tables
+{
+        fq_t t[8][16];
+
+        nibble_tables(fq_t c)
+        {
+                fq_t b = c; // c*x^(4k+j)
+                for (int k=0; k<8; ++k)
+                {
+                        t[k][0] = 0;
+                        for (int j=0; j<4; ++j)
+                        {
+                                const int bit = 1 << j;
+                                for (int x=0; x<bit; ++x)
+                                        t[k][bit|x] = b ^ t[k][x];
+                                b = (b << 1) ^ ((b >> 31) ? fq_t(F::polynomial) : 0);
+                        }
+                }
+        }
+
+        fq_t mul(fq_t s) const
+        {
+                return t[0][s & 0xf] ^ t[1][(s >> 4) & 0xf]
+                        ^ t[2][(s >> 8) & 0xf] ^ t[3][(s >> 12) & 0xf]
+                        ^ t[4][(s >> 16) & 0xf] ^ t[5][(s >> 20) & 0xf]
+                        ^ t[6][(s >> 24) & 0xf] ^ t[7][s >> 28];
+        }
+};
+
+template <bool ADD>
+static void region_generic(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        const nibble_tables t(c);
+        for (size_t i=0; i<n; ++i)
+        {
+                const fq_t p = t.mul(src[i]);
+                if (ADD) dst[i] ^= p;
+                else dst[i] = p;
+        }
+}
+
+/// \brief Prepared coefficient of #panel_generic
+typedef fq_t prepared_generic;
+
+static void panel_generic(fq_t *dst, const fq_t * const *src, size_t off,
+                          const void *p, size_t k, size_t n)
+{
+        panel_plain<fq_t, region_generic<true> >(dst, src, off, p, k, n);
+}
+
+}
+
+/// \brief The #region_ops::addto_mul_panel fields of the tier \c impl
+#define PANEL(ns, impl)                                                 \
+        sizeof(ns::prepared_##impl),                                    \
+        prepare_as<ns::prepared_##impl, ns::fq_t>,                      \
+        ns::panel_##impl
+
+/// \brief The portable tier, available on every platform
+#define GENERIC_KERNEL_SET                                              \
+        { KERNEL_GENERIC, "generic",                                    \
+          { region_generic<Field<GF256>, true>,                         \
+            region_generic<Field<GF256>, false>,                        \
+            region_generic_log<Field<GF256> >,                          \
+            sizeof(log_coef<Field<GF256> >),                            \
+            prepare_as<log_coef<Field<GF256> >, uint8_t>,               \
+            panel_generic_log<Field<GF256> >,                           \
+            prepare_log_coef<Field<GF256> > },                          \
+          { region_generic<Field<GF65536>, true>,                       \
+            region_generic<Field<GF65536>, false>,                      \
+            region_generic_log<Field<GF65536> >,                        \
+            sizeof(log_coef<Field<GF65536> >),                          \
+            prepare_as<log_coef<Field<GF65536> >, uint16_t>,            \
+            panel_generic_log<Field<GF65536> >,                         \
+            prepare_log_coef<Field<GF65536> > },                        \
+          { gf2_32::region_generic<true>, gf2_32::region_generic<false>, \
+            0, PANEL(gf2_32, generic), 0 } }
+
+#ifdef RNC_X86
+
+/// \brief Whether the CPU supports PCLMULQDQ; see kernel.cpp
+bool cpu_has_clmul();
+
+/// \brief Stores (or adds) a product vector
+#define STORE128(ADD, d, v)                                             \
+        _mm_storeu_si128(d, ADD ? _mm_xor_si128(_mm_loadu_si128(d), v) : v)
+#define STORE256(ADD, d, v)                                             \
+        _mm256_storeu_si256(d, ADD ? _mm256_xor_si256(_mm256_loadu_si256(d), v) : v)
+#define STORE512(ADD, d, v)                                             \
+        _mm512_storeu_si512(d, ADD ? _mm512_xor_si512(_mm512_loadu_si512(d), v) : v)
+
+/// \brief Kernels over GF(2^8)
+namespace gf256
+{
+typedef Field<GF256> F;
+typedef F::fq_t fq_t;
+
+/** \brief Split-nibble product tables of \c c
+
+    \c lo[x] = c*x and \c hi[x] = c*(x<<4) for every nibble \c x. Built
+    from the eight products \f$c*2^j\f$ by linearity.
+ */
+struct nibble_tables
+{
+        uint8_t lo[16], hi[16];
+
+        nibble_tables(fq_t c)
+        {
+                lo[0] = hi[0] = 0;
+                for (int j=0; j<4; ++j)
+                {
+                        const int bit = 1 << j;
+                        const fq_t l = F::mul(c, bit), h = F::mul(c, bit<<4);
+                        for (int x=0; x<bit; ++x)
+                        {
+                                lo[bit|x] = l ^ lo[x];
+                                hi[bit|x] = h ^ hi[x];
+                        }
+                }
+        }
+
+        template <bool ADD>
+        void tail(fq_t *dst, const fq_t *src, size_t n) const
+        {
+                for (size_t i=0; i<n; ++i)
+                {
+                        const fq_t p = lo[src[i] & 0x0f] ^ hi[src[i] >> 4];
+                        if (ADD) dst[i] ^= p;
+                        else dst[i] = p;
+                }
+        }
+};
+
+/// \brief Shift-and-add multiplication; does not need PSHUFB.
+template <bool ADD>
+TARGET("sse2")
+static void region_sse2(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        const __m128i poly = _mm_set1_epi8(F::polynomial & 0xff);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i+16 <= n; i+=16)
+        {
+                __m128i *d = reinterpret_cast<__m128i*>(dst+i);
+                __m128i v = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(src+i));
+                __m128i p = zero;
+                for (unsigned int b = c; b; b>>=1)
+                {
+                        if (b & 1) p = _mm_xor_si128(p, v);
+                        // v*=x: shift left, reduce where the MSB was set
+                        v = _mm_xor_si128(
+                                _mm_add_epi8(v, v),
+                                _mm_and_si128(_mm_cmpgt_epi8(zero, v), poly));
+                }
+                STORE128(ADD, d, p);
+        }
+        region_generic<F, ADD>(dst+i, src+i, c, n-i);
+}
+
+template <bool ADD>
+TARGET("ssse3")
+static size_t body_ssse3(fq_t *dst, const fq_t *src, size_t n,
+                         const nibble_tables &t)
+{
+        const __m128i tlo = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(t.lo));
+        const __m128i thi = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(t.hi));
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i+16 <= n; i+=16)
+        {
+                __m128i *d = reinterpret_cast<__m128i*>(dst+i);
+                const __m128i s = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(src+i));
+                const __m128i pl = _mm_shuffle_epi8(
+                        tlo, _mm_and_si128(s, mask));
+                const __m128i ph = _mm_shuffle_epi8(
+                        thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+                STORE128(ADD, d, _mm_xor_si128(pl, ph));
+        }
+        return i;
+}
+
+template <bool ADD>
+TARGET("avx2")
+static size_t body_avx2(fq_t *dst, const fq_t *src, size_t n,
+                        const nibble_tables &t)
+{
+        const __m256i tlo = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.lo)));
+        const __m256i thi = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.hi)));
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i+32 <= n; i+=32)
+        {
+                __m256i *d = reinterpret_cast<__m256i*>(dst+i);
+                const __m256i s = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(src+i));
+                const __m256i pl = _mm256_shuffle_epi8(
+                        tlo, _mm256_and_si256(s, mask));
+                const __m256i ph = _mm256_shuffle_epi8(
+                        thi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+                STORE256(ADD, d, _mm256_xor_si256(pl, ph));
+        }
+        return i;
+}
+
+AVX512_BEGIN
+template <bool ADD>
+TARGET("avx512f,avx512bw")
+static size_t body_avx512bw(fq_t *dst, const fq_t *src, size_t n,
+                            const nibble_tables &t)
+{
+        const __m512i tlo = _mm512_broadcast_i32x4(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.lo)));
+        const __m512i thi = _mm512_broadcast_i32x4(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.hi)));
+        const __m512i mask = _mm512_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i+64 <= n; i+=64)
+        {
+                void *d = dst+i;
+                const __m512i s = _mm512_loadu_si512(src+i);
+                const __m512i pl = _mm512_shuffle_epi8(
+                        tlo, _mm512_and_si512(s, mask));
+                const __m512i ph = _mm512_shuffle_epi8(
+                        thi, _mm512_and_si512(_mm512_srli_epi64(s, 4), mask));
+                STORE512(ADD, d, _mm512_xor_si512(pl, ph));
+        }
+        return i;
+}
+AVX512_END
+
+/** \brief GF(2^8) multiplication instruction
+
+    GF2P8MULB uses the polynomial of AES, which is the polynomial of this
+    field (GF256::polynomial).
+ */
+template <bool ADD>
+TARGET("gfni,avx2")
+static size_t body_gfni(fq_t *dst, const fq_t *src, size_t n, fq_t c)
+{
+        const __m256i cv = _mm256_set1_epi8(c);
+        size_t i = 0;
+        for (; i+32 <= n; i+=32)
+        {
+                __m256i *d = reinterpret_cast<__m256i*>(dst+i);
+                const __m256i s = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(src+i));
+                STORE256(ADD, d, _mm256_gf2p8mul_epi8(s, cv));
+        }
+        return i;
+}
+
+/// \brief Scalar \f$dst:=dst+c*src\f$ for the tails of the GFNI kernels
+static inline void tail_mul(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        for (size_t i=0; i<n; ++i)
+                dst[i] ^= F::mul(c, src[i]);
+}
+
+template <bool ADD>
+TARGET("gfni,avx2")
+static void region_gfni(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        const size_t i = body_gfni<ADD>(dst, src, n, c);
+        const nibble_tables t(c);
+        t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+/// \brief The SSSE3 kernel with the tables of the coefficient given
+template <bool ADD>
+TARGET("ssse3")
+static void apply_ssse3(fq_t *dst, const fq_t *src, size_t n,
+                        const nibble_tables &t)
+{
+        const size_t i = body_ssse3<ADD>(dst, src, n, t);
+        t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+template <bool ADD>
+TARGET("ssse3")
+static void region_ssse3(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        apply_ssse3<ADD>(dst, src, n, nibble_tables(c));
+}
+
+/// \brief The AVX2 kernel with the tables of the coefficient given
+template <bool ADD>
+TARGET("avx2")
+static void apply_avx2(fq_t *dst, const fq_t *src, size_t n,
+                       const nibble_tables &t)
+{
+        size_t i = body_avx2<ADD>(dst, src, n, t);
+        i += body_ssse3<ADD>(dst+i, src+i, n-i, t);
+        t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+template <bool ADD>
+TARGET("avx2")
+static void region_avx2(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        apply_avx2<ADD>(dst, src, n, nibble_tables(c));
+}
+
+AVX512_BEGIN
+/// \brief The AVX-512BW kernel with the tables of the coefficient given
+template <bool ADD>
+TARGET("avx512f,avx512bw")
+static void apply_avx512bw(fq_t *dst, const fq_t *src, size_t n,
+                           const nibble_tables &t)
+{
+        size_t i = body_avx512bw<ADD>(dst, src, n, t);
+        i += body_avx2<ADD>(dst+i, src+i, n-i, t);
+        i += body_ssse3<ADD>(dst+i, src+i, n-i, t);
+        t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+template <bool ADD>
+TARGET("avx512f,avx512bw")
+static void region_avx512bw(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        apply_avx512bw<ADD>(dst, src, n, nibble_tables(c));
+}
+AVX512_END
+
+// Microkernels of addto_mul_panel: the products of four source regions are
+// summed in registers, with the tables of all four coefficients held in
+// registers as well, so each destination vector is loaded and stored once
+// per four regions instead of once per region.
+
+TARGET("ssse3")
+static size_t body4_ssse3(fq_t *dst, const fq_t * const *s, size_t n,
+                          const nibble_tables *t)
+{
+        __m128i tl[4], th[4];
+        for (int u=0; u<4; ++u)
+        {
+                tl[u] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t[u].lo));
+                th[u] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t[u].hi));
+        }
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i+16 <= n; i+=16)
+        {
+                __m128i *d = reinterpret_cast<__m128i*>(dst+i);
+                __m128i acc = _mm_loadu_si128(d);
+#define MAD4_SSSE3(u)                                                   \
+                {                                                       \
+                        const __m128i v = _mm_loadu_si128(              \
+                                reinterpret_cast<const __m128i*>(s[u]+i)); \
+                        acc = _mm_xor_si128(acc, _mm_xor_si128(         \
+                                _mm_shuffle_epi8(tl[u], _mm_and_si128(v, mask)), \
+                                _mm_shuffle_epi8(th[u], _mm_and_si128(  \
+                                        _mm_srli_epi64(v, 4), mask)))); \
+                }
+                MAD4_SSSE3(0) MAD4_SSSE3(1) MAD4_SSSE3(2) MAD4_SSSE3(3)
+#undef MAD4_SSSE3
+                _mm_storeu_si128(d, acc);
+        }
+        return i;
+}
+
+TARGET("avx2")
+static size_t body4_avx2(fq_t *dst, const fq_t * const *s, size_t n,
+                         const nibble_tables *t)
+{
+        __m256i tl[4], th[4];
+        for (int u=0; u<4; ++u)
+        {
+                tl[u] = _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t[u].lo)));
+                th[u] = _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t[u].hi)));
+        }
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i+32 <= n; i+=32)
+        {
+                __m256i *d = reinterpret_cast<__m256i*>(dst+i);
+                __m256i acc = _mm256_loadu_si256(d);
+#define MAD4_AVX2(u)                                                    \
+                {                                                       \
+                        const __m256i v = _mm256_loadu_si256(           \
+                                reinterpret_cast<const __m256i*>(s[u]+i)); \
+                        acc = _mm256_xor_si256(acc, _mm256_xor_si256(   \
+                                _mm256_shuffle_epi8(tl[u], _mm256_and_si256(v, mask)), \
+                                _mm256_shuffle_epi8(th[u], _mm256_and_si256( \
+                                        _mm256_srli_epi64(v, 4), mask)))); \
+                }
+                MAD4_AVX2(0) MAD4_AVX2(1) MAD4_AVX2(2) MAD4_AVX2(3)
+#undef MAD4_AVX2
+                _mm256_storeu_si256(d, acc);
+        }
+        return i;
+}
+
+AVX512_BEGIN
+TARGET("avx512f,avx512bw")
+static size_t body4_avx512bw(fq_t *dst, const fq_t * const *s, size_t n,
+                             const nibble_tables *t)
+{
+        __m512i tl[4], th[4];
+        for (int u=0; u<4; ++u)
+        {
+                tl[u] = _mm512_broadcast_i32x4(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t[u].lo)));
+                th[u] = _mm512_broadcast_i32x4(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t[u].hi)));
+        }
+        const __m512i mask = _mm512_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i+64 <= n; i+=64)
+        {
+                __m512i acc = _mm512_loadu_si512(dst+i);
+#define MAD4_AVX512(u)                                                  \
+                {                                                       \
+                        const __m512i v = _mm512_loadu_si512(s[u]+i);   \
+                        acc = _mm512_xor_si512(acc, _mm512_xor_si512(   \
+                                _mm512_shuffle_epi8(tl[u], _mm512_and_si512(v, mask)), \
+                                _mm512_shuffle_epi8(th[u], _mm512_and_si512( \
+                                        _mm512_srli_epi64(v, 4), mask)))); \
+                }
+                MAD4_AVX512(0) MAD4_AVX512(1) MAD4_AVX512(2) MAD4_AVX512(3)
+#undef MAD4_AVX512
+                _mm512_storeu_si512(dst+i, acc);
+        }
+        return i;
+}
+AVX512_END
+
+TARGET("gfni,avx2")
+static size_t body4_gfni(fq_t *dst, const fq_t * const *s, size_t n,
+                         const fq_t *c)
+{
+        const __m256i c0 = _mm256_set1_epi8(c[0]), c1 = _mm256_set1_epi8(c[1]);
+        const __m256i c2 = _mm256_set1_epi8(c[2]), c3 = _mm256_set1_epi8(c[3]);
+        size_t i = 0;
+        for (; i+32 <= n; i+=32)
+        {
+                __m256i *d = reinterpret_cast<__m256i*>(dst+i);
+#define LOAD(u) _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s[u]+i))
+                const __m256i p01 = _mm256_xor_si256(
+                        _mm256_gf2p8mul_epi8(LOAD(0), c0),
+                        _mm256_gf2p8mul_epi8(LOAD(1), c1));
+                const __m256i p23 = _mm256_xor_si256(
+                        _mm256_gf2p8mul_epi8(LOAD(2), c2),
+                        _mm256_gf2p8mul_epi8(LOAD(3), c3));
+#undef LOAD
+                _mm256_storeu_si256(d, _mm256_xor_si256(
+                        _mm256_loadu_si256(d), _mm256_xor_si256(p01, p23)));
+        }
+        return i;
+}
+
+/** \brief #region_ops::addto_mul_panel over prepared nibble tables
+
+    Four source regions at a time by the microkernel \c B4, the symbols left
+    over and the last regions by \c B1.
+ */
+template <size_t (*B4)(fq_t *, const fq_t * const *, size_t,
+                       const nibble_tables *),
+          void (*B1)(fq_t *, const fq_t *, size_t, const nibble_tables &)>
+static void panel_tables(fq_t *dst, const fq_t * const *src, size_t off,
+                         const void *p, size_t k, size_t n)
+{
+        const nibble_tables *t = static_cast<const nibble_tables*>(p);
+        size_t u = 0;
+        for (; u+4 <= k; u+=4)
+        {
+                const fq_t *s[4] = { src[u]+off, src[u+1]+off,
+                                     src[u+2]+off, src[u+3]+off };
+                const size_t i = B4(dst, s, n, t+u);
+                for (int v=0; v<4; ++v)
+                        B1(dst+i, s[v]+i, n-i, t[u+v]);
+        }
+        for (; u<k; ++u)
+                B1(dst, src[u]+off, n, t[u]);
+}
+
+typedef fq_t prepared_sse2;
+typedef nibble_tables prepared_ssse3;
+typedef nibble_tables prepared_avx2;
+typedef nibble_tables prepared_avx512bw;
+typedef fq_t prepared_gfni;
+
+static void panel_sse2(fq_t *dst, const fq_t * const *src, size_t off,
+                       const void *p, size_t k, size_t n)
+{
+        panel_plain<fq_t, region_sse2<true> >(dst, src, off, p, k, n);
+}
+
+static void panel_ssse3(fq_t *dst, const fq_t * const *src, size_t off,
+                        const void *p, size_t k, size_t n)
+{
+        panel_tables<body4_ssse3, apply_ssse3<true> >(dst, src, off, p, k, n);
+}
+
+static void panel_avx2(fq_t *dst, const fq_t * const *src, size_t off,
+                       const void *p, size_t k, size_t n)
+{
+        panel_tables<body4_avx2, apply_avx2<true> >(dst, src, off, p, k, n);
+}
+
+static void panel_avx512bw(fq_t *dst, const fq_t * const *src, size_t off,
+                           const void *p, size_t k, size_t n)
+{
+        panel_tables<body4_avx512bw, apply_avx512bw<true> >(
+                dst, src, off, p, k, n);
+}
+
+static void panel_gfni(fq_t *dst, const fq_t * const *src, size_t off,
+                       const void *p, size_t k, size_t n)
+{
+        const fq_t *c = static_cast<const fq_t*>(p);
+        size_t u = 0;
+        for (; u+4 <= k; u+=4)
+        {
+                const fq_t *s[4] = { src[u]+off, src[u+1]+off,
+                                     src[u+2]+off, src[u+3]+off };
+                const size_t i = body4_gfni(dst, s, n, c+u);
+                for (int v=0; v<4; ++v)
+                        tail_mul(dst+i, s[v]+i, c[u+v], n-i);
+        }
+        for (; u<k; ++u)
+                region_gfni<true>(dst, src[u]+off, c[u], n);
+}
+
+}
+
+/// \brief Kernels over GF(2^16)
+namespace gf65536
+{
+typedef Field<GF65536> F;
+typedef F::fq_t fq_t;
+
+/** \brief The products \f$c*2^j\f$, for \f$j<16\f$
+
+    Multiplication by \c c is linear, so these determine it. Computed by
+    doubling rather than with the log tables, which would mostly miss the
+    cache: the coefficients of short rows are set up as often as they are
+    applied.
+ */
+struct basis
+{
+        fq_t b[16];
+
+        basis(fq_t c)
+        {
+                b[0] = c;
+                for (int j=1; j<16; ++j)
+                        b[j] = fq_t(b[j-1] << 1)
+                                ^ ((b[j-1] & 0x8000) ? F::polynomial : 0);
+        }
+};
+
+/** \brief Split-nibble product tables of \c c
+
+    A 16 bit symbol consists of four nibbles; \c lo[p][x] and \c hi[p][x] are
+    the low and high bytes of \f$c*(x<<4p)\f$ for each nibble position \c p.
+    Bytes are stored separately so that each table fits a SIMD register.
+    Built from the sixteen products \f$c*2^j\f$ by linearity.
+ */
+struct nibble_tables
+{
+        uint8_t lo[4][16], hi[4][16];
+
+        nibble_tables(const basis &b)
+        {
+                for (int p=0; p<4; ++p)
+                {
+                        lo[p][0] = hi[p][0] = 0;
+                        for (int j=0; j<4; ++j)
+                        {
+                                const int bit = 1 << j;
+                                const fq_t t = b.b[4*p + j];
+                                for (int x=0; x<bit; ++x)
+                                {
+                                        lo[p][bit|x] = (t & 0xff) ^ lo[p][x];
+                                        hi[p][bit|x] = (t >> 8) ^ hi[p][x];
+                                }
+                        }
+                }
+        }
+
+        template <bool ADD>
+        void tail(fq_t *dst, const fq_t *src, size_t n) const
+        {
+                for (size_t i=0; i<n; ++i)
+                {
+                        const fq_t s = src[i];
+                        fq_t t = 0;
+                        for (int p=0; p<4; ++p)
+                        {
+                                const int x = (s >> (4*p)) & 0x0f;
+                                t ^= lo[p][x] | (hi[p][x] << 8);
+                        }
+                        if (ADD) dst[i] ^= t;
+                        else dst[i] = t;
+                }
+        }
+};
+
+/// \brief Shift-and-add multiplication; does not need PSHUFB.
+template <bool ADD>
+TARGET("sse2")
+static void region_sse2(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        const __m128i poly = _mm_set1_epi16(F::polynomial & 0xffff);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i+8 <= n; i+=8)
+        {
+                __m128i *d = reinterpret_cast<__m128i*>(dst+i);
+                __m128i v = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(src+i));
+                __m128i p = zero;
+                for (unsigned int b = c; b; b>>=1)
+                {
+                        if (b & 1) p = _mm_xor_si128(p, v);
+                        // v*=x: shift left, reduce where the MSB was set
+                        v = _mm_xor_si128(
+                                _mm_add_epi16(v, v),
+                                _mm_and_si128(_mm_srai_epi16(v, 15), poly));
+                }
+                STORE128(ADD, d, p);
+        }
+        region_generic<F, ADD>(dst+i, src+i, c, n-i);
+}
+
+// Symbols are split into a vector of low bytes and a vector of high bytes
+// (packus), looked up nibble by nibble, and interleaved back (unpack). Both
+// packus and unpack operate within 128 bit lanes, so the wider variants
+// restore the original order as well.
+
+template <bool ADD>
+TARGET("ssse3")
+static size_t body_ssse3(fq_t *dst, const fq_t *src, size_t n,
+                         const nibble_tables &t)
+{
+        __m128i tl[4], th[4];
+        for (int p=0; p<4; ++p)
+        {
+                tl[p] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.lo[p]));
+                th[p] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.hi[p]));
+        }
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i bmask = _mm_set1_epi16(0x00ff);
+        size_t i = 0;
+        for (; i+16 <= n; i+=16)
+        {
+                __m128i *d0 = reinterpret_cast<__m128i*>(dst+i);
+                __m128i *d1 = reinterpret_cast<__m128i*>(dst+i+8);
+                const __m128i s0 = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(src+i));
+                const __m128i s1 = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(src+i+8));
+                const __m128i sl = _mm_packus_epi16(_mm_and_si128(s0, bmask),
+                                                    _mm_and_si128(s1, bmask));
+                const __m128i sh = _mm_packus_epi16(_mm_srli_epi16(s0, 8),
+                                                    _mm_srli_epi16(s1, 8));
+                const __m128i n0 = _mm_and_si128(sl, mask);
+                const __m128i n1 = _mm_and_si128(_mm_srli_epi64(sl, 4), mask);
+                const __m128i n2 = _mm_and_si128(sh, mask);
+                const __m128i n3 = _mm_and_si128(_mm_srli_epi64(sh, 4), mask);
+                const __m128i rl = _mm_xor_si128(
+                        _mm_xor_si128(_mm_shuffle_epi8(tl[0], n0),
+                                      _mm_shuffle_epi8(tl[1], n1)),
+                        _mm_xor_si128(_mm_shuffle_epi8(tl[2], n2),
+                                      _mm_shuffle_epi8(tl[3], n3)));
+                const __m128i rh = _mm_xor_si128(
+                        _mm_xor_si128(_mm_shuffle_epi8(th[0], n0),
+                                      _mm_shuffle_epi8(th[1], n1)),
+                        _mm_xor_si128(_mm_shuffle_epi8(th[2], n2),
+                                      _mm_shuffle_epi8(th[3], n3)));
+                STORE128(ADD, d0, _mm_unpacklo_epi8(rl, rh));
+                STORE128(ADD, d1, _mm_unpackhi_epi8(rl, rh));
+        }
+        return i;
+}
+
+template <bool ADD>
+TARGET("avx2")
+static size_t body_avx2(fq_t *dst, const fq_t *src, size_t n,
+                        const nibble_tables &t)
+{
+        __m256i tl[4], th[4];
+        for (int p=0; p<4; ++p)
+        {
+                tl[p] = _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.lo[p])));
+                th[p] = _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.hi[p])));
+        }
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        const __m256i bmask = _mm256_set1_epi16(0x00ff);
+        size_t i = 0;
+        for (; i+32 <= n; i+=32)
+        {
+                __m256i *d0 = reinterpret_cast<__m256i*>(dst+i);
+                __m256i *d1 = reinterpret_cast<__m256i*>(dst+i+16);
+                const __m256i s0 = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(src+i));
+                const __m256i s1 = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(src+i+16));
+                const __m256i sl = _mm256_packus_epi16(
+                        _mm256_and_si256(s0, bmask), _mm256_and_si256(s1, bmask));
+                const __m256i sh = _mm256_packus_epi16(
+                        _mm256_srli_epi16(s0, 8), _mm256_srli_epi16(s1, 8));
+                const __m256i n0 = _mm256_and_si256(sl, mask);
+                const __m256i n1 = _mm256_and_si256(_mm256_srli_epi64(sl, 4), mask);
+                const __m256i n2 = _mm256_and_si256(sh, mask);
+                const __m256i n3 = _mm256_and_si256(_mm256_srli_epi64(sh, 4), mask);
+                const __m256i rl = _mm256_xor_si256(
+                        _mm256_xor_si256(_mm256_shuffle_epi8(tl[0], n0),
+                                         _mm256_shuffle_epi8(tl[1], n1)),
+                        _mm256_xor_si256(_mm256_shuffle_epi8(tl[2], n2),
+                                         _mm256_shuffle_epi8(tl[3], n3)));
+                const __m256i rh = _mm256_xor_si256(
+                        _mm256_xor_si256(_mm256_shuffle_epi8(th[0], n0),
+                                         _mm256_shuffle_epi8(th[1], n1)),
+                        _mm256_xor_si256(_mm256_shuffle_epi8(th[2], n2),
+                                         _mm256_shuffle_epi8(th[3], n3)));
+                STORE256(ADD, d0, _mm256_unpacklo_epi8(rl, rh));
+                STORE256(ADD, d1, _mm256_unpackhi_epi8(rl, rh));
+        }
+        return i;
+}
+
+AVX512_BEGIN
+template <bool ADD>
+TARGET("avx512f,avx512bw")
+static size_t body_avx512bw(fq_t *dst, const fq_t *src, size_t n,
+                            const nibble_tables &t)
+{
+        __m512i tl[4], th[4];
+        for (int p=0; p<4; ++p)
+        {
+                tl[p] = _mm512_broadcast_i32x4(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.lo[p])));
+                th[p] = _mm512_broadcast_i32x4(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.hi[p])));
+        }
+        const __m512i mask = _mm512_set1_epi8(0x0f);
+        const __m512i bmask = _mm512_set1_epi16(0x00ff);
+        size_t i = 0;
+        for (; i+64 <= n; i+=64)
+        {
+                void *d0 = dst+i;
+                void *d1 = dst+i+32;
+                const __m512i s0 = _mm512_loadu_si512(src+i);
+                const __m512i s1 = _mm512_loadu_si512(src+i+32);
+                const __m512i sl = _mm512_packus_epi16(
+                        _mm512_and_si512(s0, bmask), _mm512_and_si512(s1, bmask));
+                const __m512i sh = _mm512_packus_epi16(
+                        _mm512_srli_epi16(s0, 8), _mm512_srli_epi16(s1, 8));
+                const __m512i n0 = _mm512_and_si512(sl, mask);
+                const __m512i n1 = _mm512_and_si512(_mm512_srli_epi64(sl, 4), mask);
+                const __m512i n2 = _mm512_and_si512(sh, mask);
+                const __m512i n3 = _mm512_and_si512(_mm512_srli_epi64(sh, 4), mask);
+                const __m512i rl = _mm512_xor_si512(
+                        _mm512_xor_si512(_mm512_shuffle_epi8(tl[0], n0),
+                                         _mm512_shuffle_epi8(tl[1], n1)),
+                        _mm512_xor_si512(_mm512_shuffle_epi8(tl[2], n2),
+                                         _mm512_shuffle_epi8(tl[3], n3)));
+                const __m512i rh = _mm512_xor_si512(
+                        _mm512_xor_si512(_mm512_shuffle_epi8(th[0], n0),
+                                         _mm512_shuffle_epi8(th[1], n1)),
+                        _mm512_xor_si512(_mm512_shuffle_epi8(th[2], n2),
+                                         _mm512_shuffle_epi8(th[3], n3)));
+                STORE512(ADD, d0, _mm512_unpacklo_epi8(rl, rh));
+                STORE512(ADD, d1, _mm512_unpackhi_epi8(rl, rh));
+        }
+        return i;
+}
+AVX512_END
+
+/** \brief Bit matrix of a byte-to-byte part of the map \f$x \mapsto c*x\f$
+
+    The map from input byte \c in to output byte \c out, in the format of
+    GF2P8AFFINEQB: byte \f$7-i\f$ of the result holds the input bits
+    contributing to output bit \c i. Byte \c j of the image of input bit
+    \c j is gathered, and the 8x8 bit matrix is transposed in three
+    swap steps.
+ */
+static uint64_t affine_matrix(const basis &b, int in, int out)
+{
+        uint64_t m = 0;
+        for (int j=0; j<8; ++j)
+                m |= uint64_t((b.b[8*in + j] >> (8*out)) & 0xff) << (8*j);
+
+        uint64_t t;
+        t = (m ^ (m >> 7)) & 0x00aa00aa00aa00aaULL;
+        m ^= t ^ (t << 7);
+        t = (m ^ (m >> 14)) & 0x0000cccc0000ccccULL;
+        m ^= t ^ (t << 14);
+        t = (m ^ (m >> 28)) & 0x00000000f0f0f0f0ULL;
+        m ^= t ^ (t << 28);
+        return __builtin_bswap64(m);
+}
+
+/** \brief The four byte-to-byte parts of the map \f$x \mapsto c*x\f$,
+    followed by the nibble tables of the scalar tail
+ */
+struct affine_tables
+{
+        uint64_t m[2][2];   ///< m[in][out], see #affine_matrix
+        nibble_tables t;
+
+        affine_tables(const basis &b) : t(b)
+        {
+                for (int in=0; in<2; ++in)
+                        for (int out=0; out<2; ++out)
+                                m[in][out] = affine_matrix(b, in, out);
+        }
+};
+
+/** \brief GF(2) affine transformations
+
+    Multiplication by \c c is a 16x16 bit matrix, applied as four 8x8 blocks
+    to the low and high bytes, split and interleaved as with PSHUFB.
+ */
+template <bool ADD>
+TARGET("gfni,avx2")
+static size_t body_gfni(fq_t *dst, const fq_t *src, size_t n,
+                        const affine_tables &a)
+{
+        const __m256i ll = _mm256_set1_epi64x(a.m[0][0]);
+        const __m256i lh = _mm256_set1_epi64x(a.m[0][1]);
+        const __m256i hl = _mm256_set1_epi64x(a.m[1][0]);
+        const __m256i hh = _mm256_set1_epi64x(a.m[1][1]);
+        const __m256i bmask = _mm256_set1_epi16(0x00ff);
+        size_t i = 0;
+        for (; i+32 <= n; i+=32)
+        {
+                __m256i *d0 = reinterpret_cast<__m256i*>(dst+i);
+                __m256i *d1 = reinterpret_cast<__m256i*>(dst+i+16);
+                const __m256i s0 = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(src+i));
+                const __m256i s1 = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(src+i+16));
+                const __m256i sl = _mm256_packus_epi16(
+                        _mm256_and_si256(s0, bmask), _mm256_and_si256(s1, bmask));
+                const __m256i sh = _mm256_packus_epi16(
+                        _mm256_srli_epi16(s0, 8), _mm256_srli_epi16(s1, 8));
+                const __m256i rl = _mm256_xor_si256(
+                        _mm256_gf2p8affine_epi64_epi8(sl, ll, 0),
+                        _mm256_gf2p8affine_epi64_epi8(sh, hl, 0));
+                const __m256i rh = _mm256_xor_si256(
+                        _mm256_gf2p8affine_epi64_epi8(sl, lh, 0),
+                        _mm256_gf2p8affine_epi64_epi8(sh, hh, 0));
+                STORE256(ADD, d0, _mm256_unpacklo_epi8(rl, rh));
+                STORE256(ADD, d1, _mm256_unpackhi_epi8(rl, rh));
+        }
+        return i;
+}
+
+/// \brief The GFNI kernel with the tables of the coefficient given
+template <bool ADD>
+TARGET("gfni,avx2")
+static void apply_gfni(fq_t *dst, const fq_t *src, size_t n,
+                       const affine_tables &a)
+{
+        const size_t i = body_gfni<ADD>(dst, src, n, a);
+        a.t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+template <bool ADD>
+TARGET("gfni,avx2")
+static void region_gfni(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        apply_gfni<ADD>(dst, src, n, affine_tables(c));
+}
+
+/// \brief The SSSE3 kernel with the tables of the coefficient given
+template <bool ADD>
+TARGET("ssse3")
+static void apply_ssse3(fq_t *dst, const fq_t *src, size_t n,
+                        const nibble_tables &t)
+{
+        const size_t i = body_ssse3<ADD>(dst, src, n, t);
+        t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+template <bool ADD>
+TARGET("ssse3")
+static void region_ssse3(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        apply_ssse3<ADD>(dst, src, n, nibble_tables(c));
+}
+
+/// \brief The AVX2 kernel with the tables of the coefficient given
+template <bool ADD>
+TARGET("avx2")
+static void apply_avx2(fq_t *dst, const fq_t *src, size_t n,
+                       const nibble_tables &t)
+{
+        size_t i = body_avx2<ADD>(dst, src, n, t);
+        i += body_ssse3<ADD>(dst+i, src+i, n-i, t);
+        t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+template <bool ADD>
+TARGET("avx2")
+static void region_avx2(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        apply_avx2<ADD>(dst, src, n, nibble_tables(c));
+}
+
+AVX512_BEGIN
+/// \brief The AVX-512BW kernel with the tables of the coefficient given
+template <bool ADD>
+TARGET("avx512f,avx512bw")
+static void apply_avx512bw(fq_t *dst, const fq_t *src, size_t n,
+                           const nibble_tables &t)
+{
+        size_t i = body_avx512bw<ADD>(dst, src, n, t);
+        i += body_avx2<ADD>(dst+i, src+i, n-i, t);
+        i += body_ssse3<ADD>(dst+i, src+i, n-i, t);
+        t.tail<ADD>(dst+i, src+i, n-i);
+}
+
+template <bool ADD>
+TARGET("avx512f,avx512bw")
+static void region_avx512bw(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        apply_avx512bw<ADD>(dst, src, n, nibble_tables(c));
+}
+AVX512_END
+
+/** \brief #region_ops::addto_mul_panel over prepared tables \c T, by \c B1
+
+    The eight tables of a coefficient fill the registers of a kernel, so the
+    source regions are taken one at a time; the tables are still built only
+    once per coefficient.
+ */
+template <class T, void (*B1)(fq_t *, const fq_t *, size_t, const T &)>
+static void panel_tables(fq_t *dst, const fq_t * const *src, size_t off,
+                         const void *p, size_t k, size_t n)
+{
+        const T *t = static_cast<const T*>(p);
+        for (size_t u=0; u<k; ++u)
+                B1(dst, src[u]+off, n, t[u]);
+}
+
+typedef fq_t prepared_sse2;
+typedef nibble_tables prepared_ssse3;
+typedef nibble_tables prepared_avx2;
+typedef nibble_tables prepared_avx512bw;
+typedef affine_tables prepared_gfni;
+
+static void panel_sse2(fq_t *dst, const fq_t * const *src, size_t off,
+                       const void *p, size_t k, size_t n)
+{
+        panel_plain<fq_t, region_sse2<true> >(dst, src, off, p, k, n);
+}
+
+static void panel_ssse3(fq_t *dst, const fq_t * const *src, size_t off,
+                        const void *p, size_t k, size_t n)
+{
+        panel_tables<nibble_tables, apply_ssse3<true> >(dst, src, off, p, k, n);
+}
+
+static void panel_avx2(fq_t *dst, const fq_t * const *src, size_t off,
+                       const void *p, size_t k, size_t n)
+{
+        panel_tables<nibble_tables, apply_avx2<true> >(dst, src, off, p, k, n);
+}
+
+static void panel_avx512bw(fq_t *dst, const fq_t * const *src, size_t off,
+                           const void *p, size_t k, size_t n)
+{
+        panel_tables<nibble_tables, apply_avx512bw<true> >(
+                dst, src, off, p, k, n);
+}
+
+static void panel_gfni(fq_t *dst, const fq_t * const *src, size_t off,
+                       const void *p, size_t k, size_t n)
+{
+        panel_tables<affine_tables, apply_gfni<true> >(dst, src, off, p, k, n);
+}
+
+}
+
+/// \brief PCLMULQDQ kernels over GF(2^32)
+namespace gf2_32
+{
+
+/** \brief \f$c*a_0\f$ and \f$c*a_1\f$, reduced by Barrett reduction
+
+    \param a Factors, zero-extended in the two 64 bit lanes
+    \param k \c c in the low, #GF2_32::barrett in the high lane
+    \param p #GF2_32::polynomial in the low lane
+    \return Products in the low halves of the two 64 bit lanes
+ */
+TARGET("sse2,pclmul")
+static inline __m128i mul2(__m128i a, __m128i k, __m128i p)
+{
+        const __m128i prod = _mm_unpacklo_epi64(
+                _mm_clmulepi64_si128(a, k, 0x00),
+                _mm_clmulepi64_si128(a, k, 0x01));
+        // quotient: ((prod >> 32) * barrett) >> 32
+        const __m128i h = _mm_srli_epi64(prod, 32);
+        const __m128i q = _mm_srli_epi64(
+                _mm_unpacklo_epi64(_mm_clmulepi64_si128(h, k, 0x10),
+                                   _mm_clmulepi64_si128(h, k, 0x11)), 32);
+        return _mm_xor_si128(
+                prod, _mm_unpacklo_epi64(_mm_clmulepi64_si128(q, p, 0x00),
+                                         _mm_clmulepi64_si128(q, p, 0x01)));
+}
+
+/** \brief Carry-less multiplication with Barrett reduction
+
+    PCLMULQDQ is not implied by any of the tiers, so this kernel falls back
+    to the portable one when the CPU lacks it.
+ */
+template <bool ADD>
+TARGET("sse2,pclmul")
+static void region_clmul(fq_t *dst, const fq_t *src, fq_t c, size_t n)
+{
+        static const bool clmul = cpu_has_clmul();
+        if (!clmul) return region_generic<ADD>(dst, src, c, n);
+        if (region_trivial<ADD>(dst, src, c, n)) return;
+
+        const __m128i k = _mm_set_epi64x(F::barrett, c);
+        const __m128i p = _mm_set_epi64x(0, F::polynomial);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i+4 <= n; i+=4)
+        {
+                __m128i *d = reinterpret_cast<__m128i*>(dst+i);
+                const __m128i s = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(src+i));
+                const __m128 lo = _mm_castsi128_ps(
+                        mul2(_mm_unpacklo_epi32(s, zero), k, p));
+                const __m128 hi = _mm_castsi128_ps(
+                        mul2(_mm_unpackhi_epi32(s, zero), k, p));
+                STORE128(ADD, d, _mm_castps_si128(
+                                 _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0))));
+        }
+        for (; i<n; ++i)
+        {
+                const fq_t r = F::mul(c, src[i]);
+                if (ADD) dst[i] ^= r;
+                else dst[i] = r;
+        }
+}
+
+/// \brief Prepared coefficient of #panel_clmul
+typedef fq_t prepared_clmul;
+
+static void panel_clmul(fq_t *dst, const fq_t * const *src, size_t off,
+                        const void *p, size_t k, size_t n)
+{
+        panel_plain<fq_t, region_clmul<true> >(dst, src, off, p, k, n);
+}
+
+}
+
+#define KERNEL_SET(tier, name, impl)                                     \
+        { tier, name,                                                   \
+          { gf256::region_##impl<true>, gf256::region_##impl<false>,    \
+            region_log<Field<GF256>, gf256::region_##impl<true> >,      \
+            PANEL(gf256, impl),                                         \
+            prepare_pow_as<gf256::prepared_##impl, Field<GF256> > },    \
+          { gf65536::region_##impl<true>, gf65536::region_##impl<false>, \
+            region_log<Field<GF65536>, gf65536::region_##impl<true> >,  \
+            PANEL(gf65536, impl),                                       \
+            prepare_pow_as<gf65536::prepared_##impl, Field<GF65536> > }, \
+          { gf2_32::region_clmul<true>, gf2_32::region_clmul<false>, 0,  \
+            PANEL(gf2_32, clmul), 0 } }
+
+/// \brief Kernel sets, indexed by #kernel_tier; bound by kernel.cpp
+extern const kernel_set kernel_sets[KERNEL_AUTO];
+const kernel_set kernel_sets[KERNEL_AUTO] = {
+        GENERIC_KERNEL_SET,
+        KERNEL_SET(KERNEL_SSE2, "sse2", sse2),
+        KERNEL_SET(KERNEL_SSSE3, "ssse3", ssse3),
+        KERNEL_SET(KERNEL_AVX2, "avx2", avx2),
+        KERNEL_SET(KERNEL_AVX512BW, "avx512bw", avx512bw),
+        KERNEL_SET(KERNEL_GFNI, "gfni", gfni),
+};
+
+#else
+
+/// \brief Kernel sets; only the generic tier is available on this platform
+extern const kernel_set kernel_sets[KERNEL_AUTO];
+const kernel_set kernel_sets[KERNEL_AUTO] = {
+        GENERIC_KERNEL_SET,
+        { KERNEL_SSE2, "sse2", { 0, 0, 0, 0, 0, 0, 0 },
+          { 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 0, 0 } },
+        { KERNEL_SSSE3, "ssse3", { 0, 0, 0, 0, 0, 0, 0 },
+          { 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 0, 0 } },
+        { KERNEL_AVX2, "avx2", { 0, 0, 0, 0, 0, 0, 0 },
+          { 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 0, 0 } },
+        { KERNEL_AVX512BW, "avx512bw", { 0, 0, 0, 0, 0, 0, 0 },
+          { 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 0, 0 } },
+        { KERNEL_GFNI, "gfni", { 0, 0, 0, 0, 0, 0, 0 },
+          { 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 0, 0 } },
+};
+
+#endif //RNC_X86
+
+}
+}
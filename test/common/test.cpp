@@ -50,11 +50,11 @@ void p(const Matrix &m, ostream& buffer)
 {
         CACHE_DIMS(m);
 
-        Row *row = m.rows;
-        for (int i=nrows; i>0; --i, ++row)
+        Row row = m.data;
+        for (int i=nrows; i>0; --i, row += m.stride)
         {
                 bool fcol = true;
-                Element *elem = *row;
+                Element *elem = row;
                 for (size_t j=0; j<ncols; ++j, ++elem)
                 {
                         if (fcol) fcol=false;
@@ -69,11 +69,11 @@ void p(const Matrix &m1, const Matrix &m2, ostream& buffer)
 {
         CACHE_DIMS(m1);
 
-        Row *rowA = m1.rows, *rowB = m2.rows;
-        for (size_t i=0; i<nrows; ++i, ++rowA, ++rowB)
+        Row rowA = m1.data, rowB = m2.data;
+        for (size_t i=0; i<nrows; ++i, rowA += m1.stride, rowB += m2.stride)
         {
                 bool fcol = true;
-                Element *elem = *rowA;
+                Element *elem = rowA;
                 for (size_t j=0; j<ncols; ++j, ++elem)
                 {
                         if (fcol) fcol=false;
@@ -84,7 +84,7 @@ void p(const Matrix &m1, const Matrix &m2, ostream& buffer)
 
                 buffer << " | ";
                 fcol = true;
-                elem = *rowB;
+                elem = rowB;
                 for (size_t j=0; j<ncols; ++j, ++elem)
                 {
                         if (fcol) fcol=false;
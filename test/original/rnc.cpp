@@ -39,6 +39,7 @@
 #include <stdio.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <vector>
 
 using namespace std;
 using namespace rnc;
@@ -215,6 +216,7 @@ try
 
                 off_t fsize;
                 Matrix m1(N, N);
+                vector<random::random_type> seeds(N);
                 auto_arr_ptr<Element> mi_data;
 
                 struct timeval begin_gen, end_gen;
@@ -222,11 +224,28 @@ try
 
                 {
                         Matrix minv(N, N);
+                        vector<size_t> dependent;
                         gettimeofday(&begin_gen, 0);
-                        do {
+                        // Only the seeds of the rows are saved
+                        for (int i=0; i<N; ++i)
+                        {
+                                seeds[i] = random::generate(&rnd_state);
+                                coding::seed_coefficients<default_field>(
+                                        seeds[i], RA(m1, i), N);
+                        }
+                        // Regenerate only the rows that were dependent
+                        while (invert_rank(m1, minv, &dependent)
+                               < size_t(N))
+                        {
                                 ++sing;
-                                rand_matr(m1, &rnd_state);
-                        } while (!invert(m1, minv));
+                                for (size_t i=0; i<dependent.size(); ++i)
+                                {
+                                        const size_t r = dependent[i];
+                                        seeds[r] = random::generate(&rnd_state);
+                                        coding::seed_coefficients<default_field>(
+                                                seeds[r], RA(m1, r), N);
+                                }
+                        }
                         gettimeofday(&end_gen, 0);
                 }
 
@@ -257,17 +276,15 @@ try
                 printf("t=%s ", timediff(begin, end));
                 printf("tp=%s\n", throughput(fsize, begin, end));
 
-                {
-                        FileMap fm(fmatr, O_SAVE, N*N*sizeof(Element));
-                        copy(m1, fm.addr());
-                }
+                FileMap_G<random::random_type>::save(
+                        &seeds[0], N*sizeof(random::random_type), fmatr);
                 {
                         FileMap fm(fout, O_SAVE, fsize);
                         copy(mc, fm.addr());
                 }
 
-                if (sing > 1)
-                        printf("# Singular matrices generated: %d\n", sing-1);
+                if (sing > 0)
+                        printf("# Singular matrices generated: %d\n", sing);
         }
 
         bool singular=false;
@@ -281,9 +298,16 @@ try
                 auto_arr_ptr<Element> mi_data;
 
                 {
-                        FileMap matr(fmatr);
+                        FileMap_G<random::random_type> matr(fmatr);
+                        if (matr.size() != off_t(N*sizeof(random::random_type)))
+                                throw string(MKStr()
+                                             << "Seed file size (" << matr.size()
+                                             << ") does not match N (" << N
+                                             << ")");
                         m1_data = new Element[N*N];
-                        memcpy(m1_data, matr.addr(), matr.size());
+                        for (int i=0; i<N; ++i)
+                                coding::seed_coefficients<default_field>(
+                                        matr.addr()[i], m1_data + i*N, N);
                 }
                 {
                         FileMap infile(fout);
@@ -302,31 +326,23 @@ try
                 const size_t ncols = fsize/N/sizeof(Element);
                 Matrix m1(m1_data, N, N);
                 Matrix mi(mi_data, N, ncols);
-                Matrix minv(N, N);
 
-                struct timeval begin_inv, end_inv;
-                gettimeofday(&begin_inv, 0);
-                if (!invert(m1, minv))
+                // Elimination on [m1|mi] decodes mi in place
+                struct timeval begin, end;
+                gettimeofday(&begin, 0);
+                if (decode(m1, mi) < size_t(N))
                 {
                         singular=true;
                         goto __break;
                 }
-                gettimeofday(&end_inv, 0);
-
-                Matrix md(N, ncols);
-
-                struct timeval begin, end;
-                gettimeofday(&begin, 0);
-                pmul(minv, mi, md);
                 gettimeofday(&end, 0);
 
-                printf("matrinv=%s ", timediff(begin_inv, end_inv));
                 printf("t=%s ", timediff(begin, end));
                 printf("tp=%s\n", throughput(fsize, begin, end));
 
                 {
                         FileMap fm(fdec, O_SAVE, fsize);
-                        copy(md, fm.addr());
+                        copy(mi, fm.addr());
                 }
         }
 
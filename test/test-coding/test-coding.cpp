@@ -0,0 +1,499 @@
+/* -*- mode: c++; coding: utf-8-unix -*-
+ *
+ * Copyright 2013 MTA SZTAKI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+   \file
+   \brief Test packet by packet coding.
+*/
+
+#include <test.h>
+#include <rnc>
+#include <iostream>
+#include <list>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+using namespace rnc::test;
+using namespace rnc::fq;
+using namespace rnc::matrix;
+using namespace rnc::coding;
+
+rnc::random::mt_state rnd_state;
+
+class Coding_TestCase : public TestCase
+{
+protected:
+        size_t _n, _cols;
+public:
+        Coding_TestCase(const string &tname, size_t n,
+                        const int gensize,
+                        const int cols)
+                : TestCase(string("coding::") + tname, n),
+                  _n(gensize),
+                  _cols(cols)
+        {}
+
+        /// \brief Whether source \c i of \c d is row \c i of \c s
+        bool equals(const Decoder &d, const Matrix &s, size_t i) const {
+                return 0 == memcmp(d.source(i), RA(s, i),
+                                   _cols*sizeof(Element));
+        }
+};
+
+/// \brief Random packets decoded one by one
+class Progressive : public Coding_TestCase
+{
+public:
+        Progressive(size_t n, const int gensize, const int cols)
+                : Coding_TestCase("Progressive (decoder(A*S) = S)",
+                                  n, gensize, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                // Singular with probability about 1/q per packet; a few
+                // spare ones make a failure unlikely enough
+                const size_t packets = _n + 8;
+                Matrix _S(_n, _cols);
+                Matrix _A(packets, _n);
+                Matrix _C(packets, _cols);
+
+                rand_matr(_S, &rnd_state);
+                rand_matr(_A, &rnd_state);
+                mul(_A, _S, _C);
+
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                Decoder d(_n, _cols);
+                size_t i;
+                for (i=0; i<packets && !d.complete(); ++i)
+                {
+                        const size_t rank = d.rank();
+                        const bool innovative = d.add(RA(_A, i), RA(_C, i));
+                        if (d.rank() != rank + innovative) return false;
+                }
+                if (!d.complete()) return false;
+
+                for (i=0; i<_n; ++i)
+                        if (!d.decoded(i) || !equals(d, _S, i)) return false;
+                return true;
+        }
+};
+
+/// \brief Packets of the encoder, compared to #mul, decoded
+class Encode : public Coding_TestCase
+{
+public:
+        Encode(size_t n, const int gensize, const int cols)
+                : Coding_TestCase("Encode (decoder(encoder(S)) = S)",
+                                  n, gensize, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                const size_t packets = _n + 8;
+                Matrix _S(_n, _cols);
+                Matrix _A(packets, _n);
+                Matrix _C(packets, _cols);
+                Matrix _M(packets, _cols);
+
+                rand_matr(_S, &rnd_state);
+
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                // Few sources per pass, to combine them in several
+                context ctx;
+                ctx.panel_depth = 3;
+                Encoder e(_S, ctx);
+                Decoder d(_n, _cols);
+                size_t i;
+                for (i=0; i<packets; ++i)
+                {
+                        e.encode(&rnd_state, RA(_A, i), RA(_C, i));
+                        d.add(RA(_A, i), RA(_C, i));
+                }
+                mul(_A, _S, _M);
+                for (i=0; i<packets; ++i)
+                        if (0 != memcmp(RA(_C, i), RA(_M, i),
+                                        _cols*sizeof(Element)))
+                                return false;
+                if (!d.complete()) return false;
+
+                for (i=0; i<_n; ++i)
+                        if (!equals(d, _S, i)) return false;
+                return true;
+        }
+};
+
+/// \brief Packets carrying the seeds of their coefficients
+class Seeded : public Coding_TestCase
+{
+public:
+        Seeded(size_t n, const int gensize, const int cols)
+                : Coding_TestCase("Seeded (decoder(seed, encoder(seed)) = S)",
+                                  n, gensize, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                const size_t packets = _n + 8;
+                Matrix _S(_n, _cols);
+                Matrix _A(1, _n);
+                Matrix _C(1, _cols);
+                Matrix _M(1, _cols);
+
+                rand_matr(_S, &rnd_state);
+
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                Encoder e(_S);
+                Decoder d(_n, _cols);
+                size_t i;
+                for (i=0; i<packets && !d.complete(); ++i)
+                {
+                        const rnc::random::random_type seed =
+                                rnc::random::generate(&rnd_state);
+                        e.encode(seed, RA(_C, 0));
+
+                        // The same vector on the other side
+                        seed_coefficients<default_field>(seed, RA(_A, 0), _n);
+                        mul(_A, _S, _M);
+                        if (0 != memcmp(RA(_C, 0), RA(_M, 0),
+                                        _cols*sizeof(Element)))
+                                return false;
+                        d.add(seed, RA(_C, 0));
+                }
+                if (!d.complete()) return false;
+
+                for (i=0; i<_n; ++i)
+                        if (!equals(d, _S, i)) return false;
+                return true;
+        }
+};
+
+/// \brief Packets mixed by a relay are decoded
+class Recode : public Coding_TestCase
+{
+public:
+        Recode(size_t n, const int gensize, const int cols)
+                : Coding_TestCase("Recode (decoder(recoder(encoder(S))) = S)",
+                                  n, gensize, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                const size_t packets = _n + 8;
+                Matrix _S(_n, _cols);
+                Matrix _A(1, _n);
+                Matrix _C(1, _cols);
+                Matrix _M(1, _cols);
+
+                rand_matr(_S, &rnd_state);
+
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                Encoder e(_S);
+                Recoder r(_n, _cols);
+                Decoder d(_n, _cols);
+                if (r.recode(&rnd_state, RA(_A, 0), RA(_C, 0)))
+                        return false;
+                size_t i;
+                for (i=0; i<packets; ++i)
+                {
+                        e.encode(&rnd_state, RA(_A, 0), RA(_C, 0));
+                        r.add(RA(_A, 0), RA(_C, 0));
+
+                        // Forwarded from the first innovative packet on,
+                        // consistent with the sources
+                        if (r.recode(&rnd_state, RA(_A, 0), RA(_C, 0))
+                            != (r.rank() > 0))
+                                return false;
+                        if (!r.rank()) continue;
+                        mul(_A, _S, _M);
+                        if (0 != memcmp(RA(_C, 0), RA(_M, 0),
+                                        _cols*sizeof(Element)))
+                                return false;
+                        d.add(RA(_A, 0), RA(_C, 0));
+                }
+                if (!d.complete()) return false;
+
+                for (i=0; i<_n; ++i)
+                        if (!equals(d, _S, i)) return false;
+                return true;
+        }
+};
+
+/// \brief A stream over a lossy channel, decoded in order
+class Window : public Coding_TestCase
+{
+public:
+        Window(size_t n, const int window, const int cols)
+                : Coding_TestCase("Window (in order over a sliding window)",
+                                  n, window, cols)
+        {}
+
+        /** \brief Delivers the sources decoded, checking them
+
+            \return Whether all the ones delivered are right
+         */
+        bool deliver(WindowDecoder &d, const Matrix &s) const {
+                for (; d.ready(); d.pop())
+                        if (0 != memcmp(d.front(), RA(s, d.next()),
+                                        _cols*sizeof(Element)))
+                                return false;
+                return true;
+        }
+
+        /** \brief Streams the sources, losing every 4th packet and the
+            ones in \f$[burst, burst+burstlen)\f$
+
+            Three packets per two sources are sent, then packets of the
+            last window until everything is delivered.
+         */
+        bool stream(size_t dwindow, size_t burst, size_t burstlen,
+                    size_t *lost) const
+        {
+                const size_t total = 5*_n + 3;
+                Matrix _S(total, _cols);
+                vector<Element> coefs(_n), payload(_cols);
+
+                rand_matr(_S, &rnd_state);
+
+                WindowEncoder e(_n, _cols);
+                WindowDecoder d(dwindow, _cols);
+                size_t sent = 0;
+                for (size_t i=0; i<total || d.next()<total; ++i)
+                {
+                        if (i < total) e.push(RA(_S, i));
+                        else if (i > 3*total) return false;
+                        for (size_t k=0; k<1+i%2; ++k, ++sent)
+                        {
+                                e.encode(&rnd_state, &coefs[0], &payload[0]);
+                                if (sent%4 == 3) continue;
+                                if (sent >= burst && sent < burst+burstlen)
+                                        continue;
+                                d.add(e.first(), e.count(),
+                                      &coefs[0], &payload[0]);
+                        }
+                        if (!deliver(d, _S)) return false;
+                }
+                *lost = d.lost();
+                return true;
+        }
+
+        bool performTest(ostream *buffer) const
+        {
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                // Nothing lost with a spare window
+                size_t lost;
+                if (!stream(2*_n, 0, 0, &lost) || lost) return false;
+                // A burst longer than the window loses some, but the
+                // stream goes on
+                return stream(_n, _n, 3*_n, &lost) && lost;
+        }
+};
+
+/// \brief Sources sent uncoded first, then coded repair packets
+class Systematic : public Coding_TestCase
+{
+public:
+        Systematic(size_t n, const int gensize, const int cols)
+                : Coding_TestCase("Systematic (decoder(S_i, encoder(S)) = S)",
+                                  n, gensize, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                Matrix _S(_n, _cols);
+                vector<Element> coefs(_n), payload(_cols);
+
+                rand_matr(_S, &rnd_state);
+
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                // Every 3rd source lost, and a repair packet sent after
+                // every 4th; the lost ones are decoded from the repair
+                // packets before and after them
+                Encoder e(_S);
+                Decoder d(_n, _cols);
+                size_t i;
+                for (i=0; i<_n; ++i)
+                {
+                        if (i%3 != 1 && !d.add_source(i, e.source(i)))
+                                return false;
+                        if (i%4 == 3)
+                        {
+                                e.encode(&rnd_state, &coefs[0], &payload[0]);
+                                d.add(&coefs[0], &payload[0]);
+                        }
+                }
+                for (i=0; i<_n+8 && !d.complete(); ++i)
+                {
+                        e.encode(&rnd_state, &coefs[0], &payload[0]);
+                        d.add(&coefs[0], &payload[0]);
+                }
+                if (!d.complete()) return false;
+                if (d.add_source(0, e.source(0))) return false;
+
+                for (i=0; i<_n; ++i)
+                        if (!d.decoded(i) || !equals(d, _S, i)) return false;
+                return true;
+        }
+};
+
+/// \brief Combinations of the packets received are rejected
+class Redundant : public Coding_TestCase
+{
+public:
+        Redundant(size_t n, const int gensize, const int cols)
+                : Coding_TestCase("Redundant (rank(A;a*A_0+A_1) = rank(A))",
+                                  n, gensize, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                Matrix _S(_n, _cols);
+                Matrix _A(_n, _n);
+                Matrix _C(_n, _cols);
+                vector<Element> coefs(_n), payload(_cols);
+
+                rand_matr(_S, &rnd_state);
+                rand_matr(_A, &rnd_state);
+                mul(_A, _S, _C);
+
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                Decoder d(_n, _cols);
+                size_t i;
+                for (i=0; i<_n; ++i)
+                {
+                        d.add(RA(_A, i), RA(_C, i));
+
+                        // A random multiple of the first packet, plus the
+                        // packet just received
+                        Element a = 0;
+                        while (!a) a = rnc::random::generate_fq(&rnd_state);
+                        memset(&coefs[0], 0, _n*sizeof(Element));
+                        memset(&payload[0], 0, _cols*sizeof(Element));
+                        addto_mul_region(&coefs[0], RA(_A, 0), a, _n);
+                        addto_mul_region(&payload[0], RA(_C, 0), a, _cols);
+                        if (i)
+                        {
+                                addto_mul_region(&coefs[0], RA(_A, i), 1, _n);
+                                addto_mul_region(&payload[0], RA(_C, i), 1,
+                                                 _cols);
+                        }
+
+                        const size_t rank = d.rank();
+                        if (d.add(&coefs[0], &payload[0])) return false;
+                        if (d.rank() != rank) return false;
+                }
+                if (!d.complete()) return true;
+
+                for (i=0; i<_n; ++i)
+                        if (!equals(d, _S, i)) return false;
+                return true;
+        }
+};
+
+/// \brief Sources received uncoded are decoded at once
+class Uncoded : public Coding_TestCase
+{
+public:
+        Uncoded(size_t n, const int gensize, const int cols)
+                : Coding_TestCase("Uncoded (decoder(e_i, S_i) = S_i)",
+                                  n, gensize, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                Matrix _S(_n, _cols);
+                Matrix _I(_n, _n);
+
+                rand_matr(_S, &rnd_state);
+                set_identity(_I);
+
+                if (buffer)
+                        (*buffer) << '(' << _n << 'x' << _cols << ')';
+
+                // Every other source first: each is decoded on arrival,
+                // while its neighbour is still missing
+                Decoder d(_n, _cols);
+                size_t i;
+                for (i=0; i<_n; i+=2)
+                {
+                        if (!d.add(RA(_I, i), RA(_S, i))) return false;
+                        if (!d.decoded(i) || !equals(d, _S, i)) return false;
+                        if (i+1 < _n && d.decoded(i+1)) return false;
+                }
+                for (i=1; i<_n; i+=2)
+                {
+                        if (!d.add(RA(_I, i), RA(_S, i))) return false;
+                        if (!d.decoded(i) || !equals(d, _S, i)) return false;
+                }
+                return d.complete();
+        }
+};
+
+int main(int, char **)
+{
+        init();
+        rnc::random::random_type seed = time(NULL);
+        cout << "Seed=" << seed << endl;
+        rnd_state.mat1 = 0x8f7011ee;
+        rnd_state.mat2 = 0xfc78ff1f;
+        rnd_state.tmat = 0x3793fdff;
+        rnc::random::init(&rnd_state, seed);
+
+        cout << "Q=" << fq_size << endl;
+
+        const int gensizes[] = {1, 5, 10, 100, 0};
+        const int colcounts[] = {1, 5, 10, 100, 0};
+#define FORALL_ij                                       \
+        for (int const * i = gensizes; *i; i++)                \
+                for (int const * j = colcounts; *j; j++)
+
+        typedef list<TestCase*> case_list;
+        case_list cases;
+        FORALL_ij cases.push_back(new Progressive(5, *i, *j));
+        FORALL_ij cases.push_back(new Redundant(5, *i, *j));
+        FORALL_ij cases.push_back(new Encode(5, *i, *j));
+        FORALL_ij cases.push_back(new Recode(5, *i, *j));
+        FORALL_ij cases.push_back(new Seeded(5, *i, *j));
+        // A window of one source can't repair the losses of the channel
+        FORALL_ij if (*i > 1) cases.push_back(new Window(5, *i, *j));
+        FORALL_ij cases.push_back(new Uncoded(2, *i, *j));
+        FORALL_ij cases.push_back(new Systematic(5, *i, *j));
+
+        int failed = 0;
+        for (case_list::const_iterator i = cases.begin();
+             i!=cases.end(); ++i)
+        {
+                failed += (*i)->execute(cout);
+        }
+
+        return failed > 0;
+}
@@ -24,6 +24,8 @@
 #include <rnc>
 #include <iostream>
 #include <list>
+#include <stdlib.h>
+#include <string.h>
 
 using namespace std;
 using namespace rnc::test;
@@ -155,6 +157,161 @@ bool divby_1(ostream *buffer)
         return t == div(a,b);
 }
 
+/** \brief Checks region_ops::addto_mul_panel of the #active_kernel
+
+    Six source regions (a microkernel group of four and two more),
+    overlapping parts of \c src at different offsets, with the non-zero
+    coefficients \c c.
+ */
+template <class F>
+bool check_panel(const typename F::fq_t *src, const typename F::fq_t *dst,
+                 typename F::fq_t *t, size_t n,
+                 const typename F::fq_t *c)
+{
+        typedef typename F::fq_t E;
+        static const size_t k = 6, off = 3;
+        const region_ops<E> &ops = F::region(*active_kernel);
+        uint64_t *prep = new uint64_t[(k*ops.prepared_size + 7) / 8];
+        const E *s[k];
+        for (size_t u=0; u<k; ++u)
+        {
+                s[u] = src + u;
+                ops.prepare(reinterpret_cast<char*>(prep)
+                            + u*ops.prepared_size, c[u]);
+        }
+        const size_t m = n - k - off;
+
+        memcpy(t, dst, m*sizeof(E));
+        ops.addto_mul_panel(t, s, off, prep, k, m);
+        bool ok = true;
+        for (size_t i=0; i<m; ++i)
+        {
+                E d = dst[i];
+                for (size_t u=0; u<k; ++u)
+                        d ^= F::mul(c[u], s[u][off+i]);
+                if (t[i] != d) ok = false;
+        }
+        delete [] prep;
+        return ok;
+}
+
+/// \brief Checks the region operations of every kernel tier supported
+bool region_1(ostream *buffer)
+{
+        // odd length, so that both the vectorized part and the tail are used
+        const size_t n = 1000 + random_element() % 64;
+        const fq_t c = random_element();
+        fq_t *src = new fq_t[n], *dst = new fq_t[n], *t = new fq_t[n];
+        fq_t cs[6];
+        for (int u=0; u<6; ++u) cs[u] = getrand_notnull();
+        for (size_t i=0; i<n; ++i)
+        {
+                src[i] = random_element();
+                dst[i] = random_element();
+        }
+        PRINT(c);
+
+        const kernel_set * const active = active_kernel;
+        bool retval = true;
+        for (int k=KERNEL_GENERIC; k<KERNEL_AUTO; ++k)
+        {
+                if (!select_kernel(kernel_tier(k))) continue;
+
+                bool ok = true;
+                memcpy(t, dst, n*sizeof(fq_t));
+                addto_mul_region(t, src, c, n);
+                for (size_t i=0; i<n; ++i)
+                        if (t[i] != add(dst[i], mul(c, src[i]))) ok = false;
+
+                memcpy(t, src, n*sizeof(fq_t));
+                mul_region(t, t, c, n);
+                for (size_t i=0; i<n; ++i)
+                        if (t[i] != mul(c, src[i])) ok = false;
+
+                memcpy(t, dst, n*sizeof(fq_t));
+                default_field::addto_mul_region_log(
+                        t, src, default_field::to_log(c), n);
+                for (size_t i=0; i<n; ++i)
+                        if (t[i] != add(dst[i], mul(c, src[i]))) ok = false;
+
+                ok = check_panel<default_field>(src, dst, t, n, cs) && ok;
+
+                if (buffer) (*buffer) << ' ' << kernel_name()
+                                      << (ok ? "" : "(FAIL)");
+                retval = retval && ok;
+        }
+        active_kernel = active;
+
+        delete [] src; delete [] dst; delete [] t;
+        return retval;
+}
+
+/// \brief Field axioms over GF(2^32)
+bool gf2_32_1(ostream *buffer)
+{
+        typedef Field<GF2_32> F;
+        F::fq_t a, b, c;
+        do {
+                a = (F::fq_t(rand()) << 16) ^ rand();
+                b = (F::fq_t(rand()) << 16) ^ rand();
+                c = (F::fq_t(rand()) << 16) ^ rand();
+        } while (!a || !b || !c);
+        if (buffer) (*buffer) << "a=" << a << ", b=" << b << ", c=" << c;
+
+        return F::mul(a, b) == F::mul(b, a)
+                && F::mul(a, F::mul(b, c)) == F::mul(F::mul(a, b), c)
+                && F::mul(a, b^c) == (F::mul(a, b) ^ F::mul(a, c))
+                && F::mul(a, F::inv(a)) == 1
+                && F::mul(b, F::div(a, b)) == a
+                && F::mul(a, 1) == a;
+}
+
+/// \brief Checks the GF(2^32) region operations of every kernel tier supported
+bool gf2_32_region(ostream *buffer)
+{
+        typedef Field<GF2_32> F;
+        const size_t n = 1000 + rand() % 64;
+        const F::fq_t c = (F::fq_t(rand()) << 16) ^ rand();
+        F::fq_t *src = new F::fq_t[n], *dst = new F::fq_t[n], *t = new F::fq_t[n];
+        for (size_t i=0; i<n; ++i)
+        {
+                src[i] = (F::fq_t(rand()) << 16) ^ rand();
+                dst[i] = (F::fq_t(rand()) << 16) ^ rand();
+        }
+        F::fq_t cs[6];
+        for (int u=0; u<6; ++u)
+                do cs[u] = (F::fq_t(rand()) << 16) ^ rand(); while (!cs[u]);
+        if (buffer) (*buffer) << "c=" << c;
+
+        const kernel_set * const active = active_kernel;
+        bool retval = true;
+        for (int k=KERNEL_GENERIC; k<KERNEL_AUTO; ++k)
+        {
+                if (!select_kernel(kernel_tier(k))) continue;
+
+                bool ok = true;
+                memcpy(t, dst, n*sizeof(F::fq_t));
+                F::addto_mul_region(t, src, c, n);
+                for (size_t i=0; i<n; ++i)
+                        if (t[i] != (dst[i] ^ F::mul(c, src[i]))) ok = false;
+
+                memcpy(t, src, n*sizeof(F::fq_t));
+                F::mul_region(t, t, c, n);
+                for (size_t i=0; i<n; ++i)
+                        if (t[i] != F::mul(c, src[i])) ok = false;
+
+                ok = check_panel<F>(src, dst, t, n, cs) && ok;
+
+                if (buffer) (*buffer) << ' ' << kernel_name()
+                                      << (ok ? "" : "(FAIL)");
+                retval = retval && ok;
+        }
+        active_kernel = active;
+
+        delete [] src; delete [] dst; delete [] t;
+        return retval;
+}
+
 int main(int, char **)
 {
         init_random();
@@ -163,6 +320,7 @@ int main(int, char **)
         init();
 
         cout << "Q=" << fq_size << endl;
+        cout << "Kernel=" << kernel_name() << endl;
 
         typedef list<TestCase*> case_list;
         case_list cases;
@@ -174,8 +332,11 @@ int main(int, char **)
         cases.push_back(new_TC(mul_3, 5));
         cases.push_back(new_TC(addto_1, 5));
         cases.push_back(new_TC(addto_mul_1, 5));
+        cases.push_back(new_TC(region_1, 5));
         cases.push_back(new_TC(div_1, 5));
         cases.push_back(new_TC(divby_1, 5));
+        cases.push_back(new_TC(gf2_32_1, 20));
+        cases.push_back(new_TC(gf2_32_region, 5));
 
         int failed = 0;
         for (case_list::const_iterator i = cases.begin();
@@ -24,6 +24,7 @@
 #include <rnc>
 #include <iostream>
 #include <list>
+#include <vector>
 #include <stdlib.h>
 #include <string.h>
 
@@ -53,9 +54,9 @@ public:
 
                 const size_t rowsize = sizeof(Element) * _cols;
                 size_t i;
-                Row *r1 = m1.rows, *r2 = m2.rows;
-                for (i=0; i<_rows; ++i, ++r1, ++r2)
-                        if (0 != memcmp(*r1, *r2, rowsize)) return false;
+                for (i=0; i<_rows; ++i)
+                        if (0 != memcmp(RA(m1,i), RA(m2,i), rowsize))
+                                return false;
                 return true;
         }
 };
@@ -86,6 +87,33 @@ public:
         }
 };
 
+/// \brief Rows of allocated matrices are aligned and do not overlap
+template <class M>
+class Storage : public Matrix_TestCase
+{
+public:
+        Storage(const string &fname, size_t n, const int rows, const int cols)
+                : Matrix_TestCase("Storage over " + fname, n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                M _A(_rows, _cols, true);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols
+                                  << ", stride=" << _A.stride << ')';
+
+                if (_A.stride < _cols) return false;
+                for (size_t i=0; i<_rows; ++i)
+                {
+                        if ((size_t)RA(_A,i) % M::ALIGNMENT) return false;
+                        for (size_t j=0; j<_cols; ++j)
+                                if (E(_A,i,j) != 0) return false;
+                }
+                return true;
+        }
+};
+
 class RndEq : public Matrix_TestCase
 {
 public:
@@ -179,6 +207,745 @@ public:
         }
 };
 
+/// \brief Inversion needing row swaps, and the rank of singular matrices
+class RankReveal : public Matrix_TestCase
+{
+public:
+        RankReveal(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("RankReveal", n, rows, cols) {}
+
+        /// \brief A*Ai == I
+        bool inverse(Matrix &_A, Matrix &_Ai) const
+        {
+                Matrix _D(_rows, _cols);
+                Matrix _I(_rows, _cols);
+                mul(_A, _Ai, _D);
+                set_identity(_I);
+                return equals(_D, _I);
+        }
+
+        bool performTest(ostream *buffer) const
+        {
+                const size_t n = _rows;
+                Matrix _A(n, n);
+                Matrix _Ai(n, n);
+                vector<size_t> dep;
+
+                // A random matrix, singular with probability about 1/q:
+                // invert fails exactly when the rank is not full
+                rand_matr(_A, &rnd_state);
+                const bool regular = invert(_A, _Ai);
+                if (regular && !inverse(_A, _Ai)) return false;
+                if ((invert_rank(_A, _Ai, &dep) == n) != regular
+                    || dep.empty() != regular)
+                        return false;
+
+                // Only the last row has a non-zero in the first column
+                do {
+                        rand_matr(_A, &rnd_state);
+                        for (size_t i=0; i+1<n; ++i)
+                                E(_A, i, 0) = 0;
+                        E(_A, n-1, 0) = 1;
+                } while (invert_rank(_A, _Ai, &dep) < n);
+                if (!dep.empty() || !inverse(_A, _Ai)) return false;
+
+                // Two rows made combinations of the others
+                rand_matr(_A, &rnd_state);
+                mul_region(RA(_A, 1), RA(_A, 0), random_element() | 1, n);
+                memcpy(RA(_A, n-1), RA(_A, 0), n*sizeof(Element));
+                addto_mul_region(RA(_A, n-1), RA(_A, 2), 1, n);
+                const size_t rank = invert_rank(_A, _Ai, &dep);
+
+                if (buffer)
+                        (*buffer) << '(' << n << 'x' << n << ") rank="
+                                  << rank << " dependent=" << dep.size();
+                if (rank > n-2 || rank + dep.size() != n) return false;
+
+                // Replacing just the dependent rows restores full rank
+                for (int tries=0; tries<10 && !dep.empty(); ++tries)
+                {
+                        for (size_t i=0; i<dep.size(); ++i)
+                        {
+                                Matrix row(RA(_A, dep[i]), 1, n);
+                                rand_matr(row, &rnd_state);
+                        }
+                        invert_rank(_A, _Ai, &dep);
+                }
+                return dep.empty() && inverse(_A, _Ai);
+        }
+};
+
+/// \brief I*A=A over the field of \c M, regardless of the default field
+template <class M>
+class FieldIdentity : public Matrix_TestCase
+{
+public:
+        FieldIdentity(const string &fname, size_t n, const int rows, const int cols)
+                : Matrix_TestCase("Identity over " + fname, n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                M _I(_rows, _rows);
+                M _A(_rows, _cols);
+                M _D(_rows, _cols);
+
+                set_identity(_I);
+                rand_matr(_A, &rnd_state);
+                pmul(_I, _A, _D);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                const size_t rowsize = sizeof(typename M::Element) * _cols;
+                for (size_t i=0; i<_rows; ++i)
+                        if (0 != memcmp(RA(_A,i), RA(_D,i), rowsize))
+                                return false;
+                return true;
+        }
+};
+
+/// \brief A*~A=I over the field of \c M
+template <class M>
+class FieldInversion : public Matrix_TestCase
+{
+public:
+        FieldInversion(const string &fname, size_t n, const int rows, const int cols)
+                : Matrix_TestCase("Inversion over " + fname, n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                M _A(_rows, _cols);
+                M _Ai(_rows, _cols);
+                M _D(_rows, _cols);
+                M _I(_rows, _cols);
+
+                rand_matr(_A, &rnd_state);
+                if (!invert(_A, _Ai)) return false;
+                pmul(_A, _Ai, _D);
+                set_identity(_I);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                const size_t rowsize = sizeof(typename M::Element) * _cols;
+                for (size_t i=0; i<_rows; ++i)
+                        if (0 != memcmp(RA(_I,i), RA(_D,i), rowsize))
+                                return false;
+                return true;
+        }
+};
+
+/// \brief pmul on a pool that is resized and restarted, compared to mul
+class PoolReuse : public Matrix_TestCase
+{
+public:
+        PoolReuse(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("PoolReuse (pmul == mul)", n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                static const int ncpus[] = { 3, 1, 4, 2 };
+                Matrix _A(_rows, _cols);
+                Matrix _B(_cols, _cols);
+                Matrix _D(_rows, _cols);
+                Matrix _P(_rows, _cols);
+
+                rand_matr(_A, &rnd_state);
+                rand_matr(_B, &rnd_state);
+                mul(_A, _B, _D);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                const int saved = NCPUS;
+                bool retval = true;
+                for (size_t k=0; k<sizeof(ncpus)/sizeof(*ncpus); ++k)
+                {
+                        NCPUS = ncpus[k];
+                        pmul(_A, _B, _P);
+                        retval = retval && equals(_D, _P);
+                        if (k == 1) rnc::pool::shutdown();
+                }
+                NCPUS = saved;
+                return retval;
+        }
+};
+
+/// \brief An exception of a task reaches the caller of pool::run
+class PoolThrow : public Matrix_TestCase
+{
+        /// \brief Throws its index, if it is \c *d
+        static void task(size_t i, void *d)
+        {
+                if (i == *reinterpret_cast<size_t*>(d))
+                        throw i;
+        }
+
+public:
+        PoolThrow(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("PoolThrow (pool::run rethrows)",
+                                  n, rows, cols) {}
+
+        bool performTest(ostream *) const
+        {
+                // Thrown by the caller, by a helper, and not at all: the
+                // pool stays usable
+                const size_t which[] = { 0, 99, 100 };
+                bool retval = true;
+                for (size_t k=0; k<sizeof(which)/sizeof(*which); ++k)
+                {
+                        size_t t = which[k];
+                        try
+                        {
+                                rnc::pool::run(task, &t, 100, 3);
+                                retval = retval && t == 100;
+                        }
+                        catch (size_t e)
+                        {
+                                retval = retval && e == which[k];
+                        }
+                }
+                return retval;
+        }
+};
+
+/// \brief pmul of a wide matrix, split into 2D tiles, compared to mul
+class TiledMul : public Matrix_TestCase
+{
+public:
+        TiledMul(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("TiledMul (pmul == mul)", n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                // Several tiles wide, not a multiple of the tile width
+                const size_t wide = 40000 + 1000*_cols + 13;
+                Matrix _A(_rows, _cols);
+                Matrix _B(_cols, wide);
+                Matrix _D(_rows, wide);
+                Matrix _P(_rows, wide);
+
+                rand_matr(_A, &rnd_state);
+                rand_matr(_B, &rnd_state);
+                mul(_A, _B, _D);
+
+                const int saved = NCPUS;
+                NCPUS = 8;
+                pmul(_A, _B, _P);
+                NCPUS = saved;
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols
+                                  << '*' << _cols << 'x' << wide << ')';
+
+                const size_t rowsize = sizeof(Element) * wide;
+                for (size_t i=0; i<_rows; ++i)
+                        if (0 != memcmp(RA(_D,i), RA(_P,i), rowsize))
+                                return false;
+                return true;
+        }
+};
+
+/// \brief Operations with explicit contexts, compared to the defaults
+class ContextOps : public Matrix_TestCase
+{
+public:
+        ContextOps(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("ContextOps (ctx == default)", n, rows, cols)
+        {}
+
+        bool performTest(ostream *buffer) const
+        {
+                Matrix _A(_rows, _cols);
+                Matrix _B(_cols, _cols);
+                Matrix _D(_rows, _cols);
+                Matrix _P(_rows, _cols);
+
+                rand_matr(_A, &rnd_state);
+                rand_matr(_B, &rnd_state);
+                mul(_A, _B, _D);
+
+                // Generic kernels, whatever the active ones are
+                const kernel_set *active = active_kernel;
+                context ctx;
+                ctx.kernel = select_kernel(KERNEL_GENERIC);
+                select_kernel(active->tier);
+                ctx.ncpus = 3;
+                // Panels narrower and shallower than the matrices
+                ctx.panel_depth = 3;
+                ctx.panel_bytes = 100;
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                pmul(_A, _B, _P, ctx);
+                if (!equals(_D, _P)) return false;
+                ctx.panel_depth = 64;
+                mul(_A, _B, _P, ctx);
+                if (!equals(_D, _P)) return false;
+
+                if (_rows != _cols) return true;
+                Matrix _Ai(_rows, _cols);
+                Matrix _Ci(_rows, _cols);
+                const bool ok = invert(_A, _Ai);
+                if (ok != invert(_A, _Ci, ctx)) return false;
+                return !ok || equals(_Ai, _Ci);
+        }
+};
+
+/// \brief Inversion by blocks of columns, compared to the unblocked one
+class BlockedInversion : public Matrix_TestCase
+{
+public:
+        BlockedInversion(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("BlockedInversion", n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                const size_t n = _rows;
+                Matrix _A(n, n);
+                Matrix _Ai(n, n);
+                Matrix _Bi(n, n);
+                vector<size_t> dep, bdep;
+
+                context plain;
+                plain.invert_block = 0;
+                // Blocks not dividing n, split among threads
+                context blocked;
+                blocked.invert_block = 3;
+                blocked.ncpus = 3;
+
+                rand_matr(_A, &rnd_state);
+                // Pivots of the first block found in its last rows
+                for (size_t i=0; i+2<n; ++i)
+                        E(_A, i, 0) = E(_A, i, 1) = 0;
+                const size_t rank = invert_rank(_A, _Ai, &dep, plain);
+                if (rank != invert_rank(_A, _Bi, &bdep, blocked))
+                        return false;
+                if (rank == n && (!bdep.empty() || !equals(_Ai, _Bi)))
+                        return false;
+
+                // Two rows made combinations of the others
+                memcpy(RA(_A, 1), RA(_A, n-1), n*sizeof(Element));
+                memcpy(RA(_A, 3), RA(_A, 0), n*sizeof(Element));
+                addto_mul_region(RA(_A, 3), RA(_A, 2), random_element(), n);
+                const size_t brank = invert_rank(_A, _Bi, &bdep, blocked);
+
+                if (buffer)
+                        (*buffer) << '(' << n << 'x' << n << ") rank="
+                                  << brank << " dependent=" << bdep.size();
+                return brank == invert_rank(_A, _Ai, &dep, plain)
+                        && brank + bdep.size() == n && brank <= n-2;
+        }
+};
+
+/// \brief Decoding by elimination on [coefficients | coded data]
+class Decode : public Matrix_TestCase
+{
+public:
+        Decode(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("Decode (decode(A, A*S) = S)", n, rows, cols)
+        {}
+
+        /// \brief Decodes from \c extra coded rows more than sources
+        bool check(size_t extra, const context &ctx) const
+        {
+                const size_t n = _rows;
+                Matrix _S(n, _cols);
+                Matrix _A(n+extra, n);
+                Matrix _C(n+extra, _cols);
+                vector<size_t> dep;
+
+                rand_matr(_S, &rnd_state);
+                rand_matr(_A, &rnd_state);
+                if (extra)
+                {
+                        // A redundant row, the sum of two others
+                        memcpy(RA(_A, n), RA(_A, 0), n*sizeof(Element));
+                        addto_mul_region(RA(_A, n), RA(_A, n+1), 1, n);
+                }
+                mul(_A, _S, _C);
+
+                const size_t rank = decode(_A, _C, &dep, ctx);
+                if (rank + dep.size() != n+extra) return false;
+                // Singular with probability about 1/q
+                if (rank < n) return true;
+
+                Matrix _D(RA(_C, 0), n, _cols, _C.stride);
+                return equals(_S, _D);
+        }
+
+        bool performTest(ostream *buffer) const
+        {
+                context plain;
+                plain.invert_block = 0;
+                context blocked;
+                blocked.invert_block = 3;
+                blocked.ncpus = 3;
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                return check(0, context()) && check(2, context())
+                        && check(0, plain) && check(2, plain)
+                        && check(0, blocked) && check(2, blocked);
+        }
+};
+
+/// \brief Multiplication by a log-domain matrix, compared to the elements
+template <class M, class L>
+class LogMul : public Matrix_TestCase
+{
+public:
+        LogMul(const string &fname, size_t n, const int rows, const int cols)
+                : Matrix_TestCase("LogMul over " + fname, n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                L _L(_rows, _cols);
+                M _A(_rows, _cols);
+                M _B(_cols, _cols);
+                M _D(_rows, _cols);
+                M _P(_rows, _cols);
+                M _E(_rows, _cols);
+
+                rand_matr(_L, &rnd_state);
+                from_log(_L, _A);
+                rand_matr(_B, &rnd_state);
+                mul(_L, _B, _D);
+                pmul(_L, _B, _P);
+                mul(_A, _B, _E);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                const size_t rowsize = sizeof(typename M::Element) * _cols;
+                for (size_t i=0; i<_rows; ++i)
+                        if (0 != memcmp(RA(_E,i), RA(_D,i), rowsize)
+                            || 0 != memcmp(RA(_E,i), RA(_P,i), rowsize))
+                                return false;
+                return true;
+        }
+};
+
+/// \brief A*~A=I, ~A in the log domain
+template <class M, class L>
+class LogInversion : public Matrix_TestCase
+{
+public:
+        LogInversion(const string &fname, size_t n, const int rows, const int cols)
+                : Matrix_TestCase("LogInversion over " + fname, n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                L _L(_rows, _cols);
+                L _Li(_rows, _cols);
+                M _A(_rows, _cols);
+                M _D(_rows, _cols);
+                M _I(_rows, _cols);
+
+                do rand_matr(_L, &rnd_state);
+                while (!invert(_L, _Li));
+                from_log(_L, _A);
+                // (~A)*A = I
+                pmul(_Li, _A, _D);
+                set_identity(_I);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                const size_t rowsize = sizeof(typename M::Element) * _cols;
+                for (size_t i=0; i<_rows; ++i)
+                        if (0 != memcmp(RA(_I,i), RA(_D,i), rowsize))
+                                return false;
+                return true;
+        }
+};
+
+/// \brief GF(2) multiplication, compared to the definition
+class BitMul : public Matrix_TestCase
+{
+public:
+        BitMul(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("BitMul (A*B over GF(2))", n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                // B is wide, so that several strips are used
+                const size_t bcols = 64*_cols + 7;
+                BitMatrix _A(_rows, _cols);
+                BitMatrix _B(_cols, bcols);
+                BitMatrix _D(_rows, bcols);
+                BitMatrix _P(_rows, bcols);
+
+                rand_matr(_A, &rnd_state);
+                rand_matr(_B, &rnd_state);
+                mul(_A, _B, _D);
+                pmul(_A, _B, _P);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                for (size_t i=0; i<_rows; ++i)
+                        for (size_t j=0; j<bcols; ++j)
+                        {
+                                bool e = false;
+                                for (size_t k=0; k<_cols; ++k)
+                                        e ^= _A.get(i, k) && _B.get(k, j);
+                                if (e != _D.get(i, j) || e != _P.get(i, j))
+                                        return false;
+                        }
+                return true;
+        }
+};
+
+/// \brief A*~A=I over GF(2)
+class BitInversion : public Matrix_TestCase
+{
+public:
+        BitInversion(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("BitInversion (A * ~A = I)", n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                BitMatrix _A(_rows, _cols);
+                BitMatrix _Ai(_rows, _cols);
+                BitMatrix _D(_rows, _cols);
+                BitMatrix _I(_rows, _cols);
+
+                // A random binary matrix is singular with probability ~0.71
+                do rand_matr(_A, &rnd_state);
+                while (!invert(_A, _Ai));
+                mul(_A, _Ai, _D);
+                set_identity(_I);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                for (size_t i=0; i<_rows; ++i)
+                        if (0 != memcmp(_I.rows[i], _D.rows[i],
+                                        _I.nwords*sizeof(BitMatrix::Word)))
+                                return false;
+                return true;
+        }
+};
+
+/// \brief Multiplication by a sparse matrix, compared to the dense one
+class SparseMul : public Matrix_TestCase
+{
+public:
+        SparseMul(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("SparseMul (mul(sparse A) == mul(A))",
+                                  n, rows, cols) {}
+
+        bool performTest(ostream *buffer) const
+        {
+                SparseMatrix _A(_rows, _cols);
+                Matrix _Ad(_rows, _cols);
+                Matrix _B(_cols, _cols);
+                Matrix _D(_rows, _cols);
+                Matrix _P(_rows, _cols);
+
+                rand_matr(_A, 0.2, &rnd_state);
+                copy(_A, _Ad);
+                rand_matr(_B, &rnd_state);
+                mul(_Ad, _B, _D);
+
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ", "
+                                  << _A.nnz() << " non-zero)";
+
+                for (size_t i=0; i<_rows; ++i)
+                        if (!_A.nnz(i)) return false;
+
+                mul(_A, _B, _P);
+                if (!equals(_D, _P)) return false;
+                context ctx;
+                ctx.ncpus = 3;
+                ctx.tile_min_row_bytes = 1;
+                pmul(_A, _B, _P, ctx);
+                return equals(_D, _P);
+        }
+};
+
+/// \brief Decoding by a sparse matrix, compared to the dense #decode
+class SparseDecode : public Matrix_TestCase
+{
+public:
+        SparseDecode(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("SparseDecode (decode(sparse A, A*S) = S)",
+                                  n, rows, cols)
+        {}
+
+        /// \brief Decodes from \c extra coded rows more than sources
+        bool check(size_t extra, double density) const
+        {
+                const size_t n = _rows;
+                Matrix _S(n, _cols);
+                SparseMatrix _A(n+extra, n);
+                Matrix _Ad(n+extra, n);
+                Matrix _C(n+extra, _cols);
+                Matrix _Cd(n+extra, _cols);
+                vector<size_t> dep, ddep;
+
+                rand_matr(_S, &rnd_state);
+                rand_matr(_A, density, &rnd_state);
+                copy(_A, _Ad);
+                mul(_A, _S, _C);
+                copy(_C, _Cd);
+
+                const size_t rank = decode(_A, _C, &dep);
+                if (rank != decode(_Ad, _Cd, &ddep)) return false;
+                if (rank + dep.size() != n+extra) return false;
+                if (rank < n) return true;
+
+                Matrix _D(RA(_C, 0), n, _cols, _C.stride);
+                return equals(_S, _D);
+        }
+
+        bool performTest(ostream *buffer) const
+        {
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                // Mostly peeled, then mostly dense
+                return check(_rows/2 + 2, 2.0/_rows) && check(2, 0.3)
+                        && check(0, 1);
+        }
+};
+
+/// \brief Batches of generations, compared to one by one
+class Batch : public Matrix_TestCase
+{
+public:
+        Batch(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("Batch (decode_batch(pmul_batch(A, S)) = S)",
+                                  n, rows, cols)
+        {}
+
+        /// \brief A batch of \c count generations, on \c ncpus threads
+        bool check(size_t count, int ncpus) const
+        {
+                const size_t n = _rows;
+                vector<Matrix*> S, A, Ad, C, M;
+                vector<mul_job<default_field> > muls;
+                vector<decode_job<default_field> > decodes;
+                vector<vector<size_t> > dep(count);
+                for (size_t g=0; g<count; ++g)
+                {
+                        S.push_back(new Matrix(n, _cols));
+                        A.push_back(new Matrix(n, n));
+                        Ad.push_back(new Matrix(n, n));
+                        C.push_back(new Matrix(n, _cols));
+                        M.push_back(new Matrix(n, _cols));
+                        rand_matr(*S[g], &rnd_state);
+                        rand_matr(*A[g], &rnd_state);
+                        copy(*A[g], *Ad[g]);
+                        mul(*A[g], *S[g], *M[g]);
+
+                        const mul_job<default_field> mj = { A[g], S[g], C[g] };
+                        muls.push_back(mj);
+                        const decode_job<default_field> dj = {
+                                Ad[g], C[g], &dep[g], 0 };
+                        decodes.push_back(dj);
+                }
+
+                context ctx;
+                ctx.ncpus = ncpus;
+                ctx.tile_min_row_bytes = 1;
+                bool ok = true;
+                pmul_batch(muls, ctx);
+                for (size_t g=0; g<count; ++g)
+                        ok = ok && equals(*C[g], *M[g]);
+                if (ok) decode_batch(decodes, ctx);
+                // Singular with probability about 1/q
+                for (size_t g=0; g<count; ++g)
+                        ok = ok && decodes[g].rank + dep[g].size() == n
+                                && (decodes[g].rank < n
+                                    || equals(*C[g], *S[g]));
+
+                for (size_t g=0; g<count; ++g)
+                {
+                        delete S[g]; delete A[g]; delete Ad[g];
+                        delete C[g]; delete M[g];
+                }
+                return ok;
+        }
+
+        bool performTest(ostream *buffer) const
+        {
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                // By generations, by tiles, and on the calling thread
+                return check(7, 3) && check(2, 8) && check(3, 1)
+                        && check(0, 3);
+        }
+};
+
+/// \brief Batches of small matrices, compared to one by one
+class BatchInversion : public Matrix_TestCase
+{
+public:
+        BatchInversion(size_t n, const int rows, const int cols)
+                : Matrix_TestCase("BatchInversion (invert_batch = invert)",
+                                  n, rows, cols)
+        {}
+
+        /// \brief A batch of \c count matrices, on \c ncpus threads
+        bool check(size_t count, int ncpus) const
+        {
+                const size_t n = _rows;
+                // Rows left below the last matrix, to be ignored
+                const size_t extra = n - 1;
+                Matrix m(count*n + extra, n), res(count*n + extra, n);
+                Matrix inv(n, n);
+                rand_matr(m, &rnd_state);
+                set_zero(res);
+                // A singular one, with a null column if n == 1
+                const size_t bad = count / 2;
+                if (count && n > 1)
+                        memcpy(RA(m, bad*n + 1), RA(m, bad*n),
+                               n*sizeof(Element));
+                else if (count)
+                        E(m, bad, 0) = 0;
+
+                context ctx;
+                ctx.ncpus = ncpus;
+                vector<size_t> singular;
+                const size_t inverted = invert_batch(m, res, &singular, ctx);
+
+                bool ok = inverted + singular.size() == count;
+                size_t s = 0;
+                for (size_t b=0; ok && b<count; ++b)
+                {
+                        Matrix mb(RA(m, b*n), n, n, m.stride);
+                        Matrix rb(RA(res, b*n), n, n, res.stride);
+                        const bool regular = invert(mb, inv);
+                        const bool listed = s < singular.size()
+                                && singular[s] == b;
+                        if (listed) ++s;
+                        ok = regular != listed
+                                && (!regular || equals(inv, rb));
+                }
+                for (size_t i=count*n; i<count*n + extra; ++i)
+                        for (size_t j=0; j<n; ++j)
+                                ok = ok && E(res, i, j) == 0;
+                return ok && s == singular.size()
+                        && (!count || singular.size() >= 1);
+        }
+
+        bool performTest(ostream *buffer) const
+        {
+                if (buffer)
+                        (*buffer) << '(' << _rows << 'x' << _cols << ')';
+
+                // A partial group, several groups, and none; the larger
+                // matrices are inverted one by one
+                return check(3, 1) && check(150, 3) && check(0, 2);
+        }
+};
+
 int main(int, char **)
 {
         BLOCK_SIZE = 4;
@@ -187,6 +954,11 @@ int main(int, char **)
         init();
         rnc::random::random_type seed = time(NULL);
         cout << "Seed=" << seed << endl;
+        // The reference parameters of TinyMT: with zero ones, the generator
+        // is linear enough for some seeds to make only singular BitMatrices
+        rnd_state.mat1 = 0x8f7011ee;
+        rnd_state.mat2 = 0xfc78ff1f;
+        rnd_state.tmat = 0x3793fdff;
         rnc::random::init(&rnd_state, seed);
 
         cout << "Q=" << fq_size << endl;
@@ -202,9 +974,41 @@ int main(int, char **)
         typedef list<TestCase*> case_list;
         case_list cases;
         FORALL_ij_square cases.push_back(new Bootstrap(1, *i, *j));
+        FORALL_ij cases.push_back(new Storage<Matrix256>("GF(2^8)", 1, *i, *j));
+        FORALL_ij cases.push_back(
+                new Storage<Matrix65536>("GF(2^16)", 1, *i, *j));
         FORALL_ij cases.push_back(new Identity(5, *i, *j));
         FORALL_ij if (*i>1 && *j>1) cases.push_back(new RndEq(5, *i, *j));
         FORALL_ij_square cases.push_back(new Inversion(5, *i, *j));
+        FORALL_ij_square if (*i >= 5) cases.push_back(new RankReveal(5, *i, *j));
+        FORALL_ij cases.push_back(
+                new FieldIdentity<Matrix256>("GF(2^8)", 5, *i, *j));
+        FORALL_ij cases.push_back(
+                new FieldIdentity<Matrix65536>("GF(2^16)", 5, *i, *j));
+        FORALL_ij cases.push_back(
+                new FieldIdentity<Matrix2_32>("GF(2^32)", 5, *i, *j));
+        FORALL_ij_square cases.push_back(new FieldInversion<Matrix2_32>(
+                                                 "GF(2^32)", 5, *i, *j));
+        FORALL_ij cases.push_back(new PoolReuse(2, *i, *j));
+        cases.push_back(new PoolThrow(2, 1, 1));
+        FORALL_ij if (*j < 100) cases.push_back(new TiledMul(1, *i, *j));
+        FORALL_ij cases.push_back(new ContextOps(2, *i, *j));
+        FORALL_ij_square if (*i >= 5) cases.push_back(
+                new BlockedInversion(5, *i, *j));
+        FORALL_ij cases.push_back(new Decode(5, *i, *j));
+        FORALL_ij cases.push_back(new SparseMul(5, *i, *j));
+        FORALL_ij cases.push_back(new SparseDecode(5, *i, *j));
+        FORALL_ij cases.push_back(new Batch(2, *i, *j));
+        FORALL_ij_square cases.push_back(new BatchInversion(2, *i, *j));
+        FORALL_ij cases.push_back(
+                new LogMul<Matrix256, LogMatrix256>("GF(2^8)", 5, *i, *j));
+        FORALL_ij cases.push_back(
+                new LogMul<Matrix65536, LogMatrix65536>("GF(2^16)", 5, *i, *j));
+        FORALL_ij_square cases.push_back(
+                new LogInversion<Matrix65536, LogMatrix65536>(
+                        "GF(2^16)", 5, *i, *j));
+        FORALL_ij cases.push_back(new BitMul(5, *i, *j));
+        FORALL_ij_square cases.push_back(new BitInversion(5, *i, *j));
 
         Matrix ii(5, 5);
         set_identity(ii);